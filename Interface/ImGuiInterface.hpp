@@ -5,7 +5,24 @@
 
 enum ImGuiInitFlags {
     NoWindowDecoration = 1,
-    ShowDemoWindow = 2
+    ShowDemoWindow = 2,
+    // Only render when there is input or a frame is asked for through Redraw, instead of at the vsync rate.
+    IdleRendering = 4,
+    // No window and no OpenGL: frames are only built into ImDrawData. For tests and benchmarks on machines without a gpu.
+    // on_graphics_init is not called, since there are no graphics to initialize.
+    Headless = 8,
+    // Render into an offscreen framebuffer of an invisible window, e.g. under Mesa's llvmpipe. FrameCapture still works.
+    Offscreen = 16,
+    // Ask for an OpenGL 4.5 context and render with ImGuiRendererGL45 (persistently mapped buffers, batched draws).
+    // Falls back to the OpenGL 3 renderer when 4.5 is not available.
+    PersistentMappedRenderer = 32,
+    // Present the first frame before calling on_graphics_init, and build the fonts while the window is created.
+    // The texture sideloader context is created before on_graphics_init is called.
+    // imgui_calls runs one full frame before on_graphics_init, so it must cope with what on_graphics_init sets up being missing.
+    // The first font on_graphics_init adds becomes io.FontDefault, unless it sets one itself.
+    DeferredInit = 64,
+    // Print how long each step of the startup took once the first frame is presented.
+    ReportStartup = 128
 };
 
 using ImGuiCallsCB = int (*)();
@@ -13,8 +30,36 @@ struct WindowInit {
     const char* title;
     int width;
     int height;
+    // With Headless or Offscreen: stop after this many frames. Zero runs until imgui_calls() returns a value < 0.
+    int headless_frames = 0;
+    // Record the ImDrawData of every frame into this file (see DrawCapture), to be played back by ImGuiReplayDrawData().
+    const char* draw_capture_file = nullptr;
+    // Record the input of every frame into this file (see InputPlayback).
+    const char* input_record_file = nullptr;
+    // Play back input recorded into this file instead of using the real input, then print frame times and allocations and stop.
+    const char* input_playback_file = nullptr;
+    // Load the font atlas from this file instead of building it, or save it there once built (see FontCache).
+    const char* font_cache_file = nullptr;
 };
 /**
  * When imgui_calls() returns a value < 0, then shutdown ImGui.
  */
-int ImGuiMain(WindowInit window_init, ImGuiCallsCB imgui_calls, void (*on_graphics_init)(), ImGuiInitFlags init_flags);
\ No newline at end of file
+int ImGuiMain(WindowInit window_init, ImGuiCallsCB imgui_calls, void (*on_graphics_init)(), ImGuiInitFlags init_flags);
+
+/**
+ * Feed the frames recorded in capture_file to the renderer, without running any UI code, then print how long rendering took.
+ * window_init.headless_frames is ignored; the replay stops after the last recorded frame.
+ * Run it with and without PersistentMappedRenderer to compare the renderers on the same frames.
+ * Returns non-zero if the file cannot be played back.
+ */
+int ImGuiReplayDrawData(WindowInit window_init, const char* capture_file, ImGuiInitFlags init_flags);
+
+struct StartupPhase {
+    const char* name;
+    double milliseconds;
+};
+/**
+ * How long each step of the last ImGuiMain() startup took, up to the first frame being presented.
+ * Returns the number of phases; *phases stays valid until ImGuiMain() is called again.
+ */
+int ImGuiStartupPhases(const StartupPhase** phases);
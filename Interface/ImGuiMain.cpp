@@ -6,8 +6,19 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include <stdio.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
 
 #include "ImGuiInterface.hpp"
+#include "ImGuiRendererGL45.hpp"
+#include "../tools/DrawCapture/DrawCapture.hpp"
+#include "../tools/FontCache/FontCache.hpp"
+#include "../tools/FrameCapture/FrameCapture.hpp"
+#include "../tools/ImageLoad/ImageLoad.hpp"
+#include "../tools/InputPlayback/InputPlayback.hpp"
+#include "../tools/Profiler/Profiler.hpp"
+#include "../tools/Redraw/Redraw.hpp"
 
 // About Desktop OpenGL function loaders:
 //  Modern desktop OpenGL doesn't have a standard portable header file to load OpenGL function pointers.
@@ -48,13 +59,241 @@ static void glfw_error_callback(int error, const char* description)
     fprintf(stderr, "Glfw Error %d: %s\n", error, description);
 }
 
+/**
+ * Start the recordings and playback asked for in window_init. Returns false if a file cannot be created or played back.
+ */
+static bool startRecordings(const WindowInit& window_init)
+{
+    if(window_init.draw_capture_file && !DrawCapture::startRecording(window_init.draw_capture_file)){
+        fprintf(stderr, "Failed to create the draw capture %s!\n", window_init.draw_capture_file);
+        return false;
+    }
+    if(window_init.input_record_file && !InputPlayback::startRecording(window_init.input_record_file)){
+        fprintf(stderr, "Failed to create the input recording %s!\n", window_init.input_record_file);
+        DrawCapture::stopRecording();
+        return false;
+    }
+    if(window_init.input_playback_file && !InputPlayback::startPlayback(window_init.input_playback_file)){
+        fprintf(stderr, "Failed to open the input recording %s!\n", window_init.input_playback_file);
+        DrawCapture::stopRecording();
+        InputPlayback::stopRecording();
+        return false;
+    }
+    return true;
+}
+
+static void stopRecordings()
+{
+    DrawCapture::stopRecording();
+    InputPlayback::stopRecording();
+    if(InputPlayback::isPlaying() || InputPlayback::playbackFinished()){
+        InputPlayback::printStats(InputPlayback::playbackStats());
+        InputPlayback::stopPlayback();
+    }
+}
+
+/**
+ * Run the frames without a window or OpenGL. Every frame is built into ImDrawData, which is then dropped.
+ * Time advances by a fixed 1/60th of a second per frame, so runs are repeatable.
+ */
+static int ImGuiMainHeadless(WindowInit window_init, ImGuiCallsCB imgui_calls, ImGuiInitFlags init_flags)
+{
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(static_cast<float>(window_init.width), static_cast<float>(window_init.height));
+    io.IniFilename = nullptr; // Runs should not depend on, or leave behind, saved window positions.
+    // Same mapping as imgui_impl_glfw, so keys recorded in a window replay the same here.
+    io.KeyMap[ImGuiKey_Tab] = GLFW_KEY_TAB;
+    io.KeyMap[ImGuiKey_LeftArrow] = GLFW_KEY_LEFT;
+    io.KeyMap[ImGuiKey_RightArrow] = GLFW_KEY_RIGHT;
+    io.KeyMap[ImGuiKey_UpArrow] = GLFW_KEY_UP;
+    io.KeyMap[ImGuiKey_DownArrow] = GLFW_KEY_DOWN;
+    io.KeyMap[ImGuiKey_PageUp] = GLFW_KEY_PAGE_UP;
+    io.KeyMap[ImGuiKey_PageDown] = GLFW_KEY_PAGE_DOWN;
+    io.KeyMap[ImGuiKey_Home] = GLFW_KEY_HOME;
+    io.KeyMap[ImGuiKey_End] = GLFW_KEY_END;
+    io.KeyMap[ImGuiKey_Insert] = GLFW_KEY_INSERT;
+    io.KeyMap[ImGuiKey_Delete] = GLFW_KEY_DELETE;
+    io.KeyMap[ImGuiKey_Backspace] = GLFW_KEY_BACKSPACE;
+    io.KeyMap[ImGuiKey_Space] = GLFW_KEY_SPACE;
+    io.KeyMap[ImGuiKey_Enter] = GLFW_KEY_ENTER;
+    io.KeyMap[ImGuiKey_Escape] = GLFW_KEY_ESCAPE;
+    io.KeyMap[ImGuiKey_KeyPadEnter] = GLFW_KEY_KP_ENTER;
+    io.KeyMap[ImGuiKey_A] = GLFW_KEY_A;
+    io.KeyMap[ImGuiKey_C] = GLFW_KEY_C;
+    io.KeyMap[ImGuiKey_V] = GLFW_KEY_V;
+    io.KeyMap[ImGuiKey_X] = GLFW_KEY_X;
+    io.KeyMap[ImGuiKey_Y] = GLFW_KEY_Y;
+    io.KeyMap[ImGuiKey_Z] = GLFW_KEY_Z;
+    ImGui::StyleColorsDark();
+
+    if(window_init.font_cache_file && !FontCache::load(io.Fonts, window_init.font_cache_file))
+        FontCache::save(io.Fonts, window_init.font_cache_file);
+    // There is no renderer to upload the font atlas to, but NewFrame() still needs it built.
+    unsigned char* pixels;
+    int atlas_width, atlas_height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &atlas_width, &atlas_height);
+
+    bool show_demo_window = (init_flags & ShowDemoWindow) == ShowDemoWindow;
+    Profiler::setThreadName("Main");
+    if(!startRecordings(window_init)){
+        ImGui::DestroyContext();
+        return 1;
+    }
+    for(int frame = 0; window_init.headless_frames == 0 || frame < window_init.headless_frames; frame++)
+    {
+        Profiler::beginFrame();
+        io.DeltaTime = 1.0f / 60.0f;
+        FontCache::update(io.Fonts);
+        InputPlayback::processFrame(io);
+        if(InputPlayback::playbackFinished())
+            break;
+        {
+            PROFILE_ZONE("NewFrame");
+            ImGui::NewFrame();
+        }
+        if (show_demo_window)
+            ImGui::ShowDemoWindow(&show_demo_window);
+
+        bool quit = false;
+        if (imgui_calls){
+            PROFILE_ZONE("imgui_calls");
+            quit = imgui_calls() < 0;
+        }
+        {
+            PROFILE_ZONE("Render");
+            ImGui::Render();
+        }
+        DrawCapture::captureFrame(ImGui::GetDrawData());
+        Profiler::endFrame();
+        if (quit)
+            break;
+    }
+
+    stopRecordings();
+    ImGui::DestroyContext();
+    return 0;
+}
+
+// Set while ImGuiReplayDrawData() runs: the recorded frames are rendered instead of the ones built by ImGui.
+static DrawCapture::Replay* replay = nullptr;
+static size_t replay_frame = 0;
+static std::vector<uint64_t> replay_render_times;
+
+// Which renderer ImGuiMain picked: ImGuiRendererGL45 or imgui_impl_opengl3.
+static bool use_gl45_renderer = false;
+
+static void ReloadFontsTexture()
+{
+    if(!ImGui::GetIO().Fonts->TexID)
+        return; // Not uploaded yet; the renderer uploads it on its first frame.
+    if(use_gl45_renderer){
+        ImGui_ImplOpenGL45_DestroyFontsTexture();
+        ImGui_ImplOpenGL45_CreateFontsTexture();
+    } else {
+        ImGui_ImplOpenGL3_DestroyFontsTexture();
+        ImGui_ImplOpenGL3_CreateFontsTexture();
+    }
+}
+
+static void RenderDrawData(ImDrawData* draw_data)
+{
+    if(use_gl45_renderer)
+        ImGui_ImplOpenGL45_RenderDrawData(draw_data);
+    else
+        ImGui_ImplOpenGL3_RenderDrawData(draw_data);
+}
+
+// The startup of the last ImGuiMain() call, see ImGuiStartupPhases().
+static std::vector<StartupPhase> startup_phases;
+static uint64_t startup_phase_start = 0;
+
+/**
+ * End the current startup phase; the next one starts now.
+ */
+static void EndStartupPhase(const char* name)
+{
+    uint64_t now = Profiler::now();
+    startup_phases.push_back({name, (now - startup_phase_start) / 1e6});
+    startup_phase_start = now;
+}
+
+static void PrintStartupPhases()
+{
+    double total = 0.0;
+    printf("Startup:\n");
+    for(const StartupPhase& phase: startup_phases){
+        printf("  %-24s %8.2f ms\n", phase.name, phase.milliseconds);
+        total += phase.milliseconds;
+    }
+    printf("  %-24s %8.2f ms\n", "Total", total);
+}
+
+int ImGuiStartupPhases(const StartupPhase** phases)
+{
+    *phases = startup_phases.data();
+    return static_cast<int>(startup_phases.size());
+}
+
+/**
+ * Load the fonts from the cache file, or build them and save them there.
+ */
+static void BuildFonts(ImFontAtlas* atlas, const char* font_cache_file)
+{
+    if(font_cache_file){
+        if(!FontCache::load(atlas, font_cache_file))
+            FontCache::save(atlas, font_cache_file);
+    } else {
+        unsigned char* pixels;
+        int width, height;
+        atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+    }
+}
+
 GLFWwindow* window = nullptr;
 int ImGuiMain(WindowInit window_init, ImGuiCallsCB imgui_calls, void (*on_graphics_init)(), ImGuiInitFlags init_flags)
 {
+    if((init_flags & Headless) == Headless)
+        return ImGuiMainHeadless(window_init, imgui_calls, init_flags);
+    bool offscreen = (init_flags & Offscreen) == Offscreen;
+    bool deferred_init = (init_flags & DeferredInit) == DeferredInit;
+    startup_phases.clear();
+    startup_phase_start = Profiler::now();
+
+    // Setup Dear ImGui context
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO(); (void)io;
+    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
+    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
+
+    // Setup Dear ImGui style
+    ImGui::StyleColorsDark();
+    //ImGui::StyleColorsClassic();
+
+    // Without on_graphics_init adding fonts first, the atlas can be built while the window and the context are created.
+    // Nothing else touches the atlas until the thread is joined before the first frame.
+    std::thread font_builder;
+    if(deferred_init)
+        font_builder = std::thread([atlas = io.Fonts, font_cache_file = window_init.font_cache_file](){
+            Profiler::setThreadName("Font builder");
+            PROFILE_ZONE("Build fonts");
+            BuildFonts(atlas, font_cache_file);
+        });
+    auto fail = [&](){
+        if(font_builder.joinable())
+            font_builder.join();
+        ImGui::DestroyContext();
+        return 1;
+    };
+    EndStartupPhase("ImGui context");
+
     // Setup window
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit())
-        return 1;
+        return fail();
+    EndStartupPhase("glfwInit");
 
     // Decide GL+GLSL versions
 #if __APPLE__
@@ -75,12 +314,34 @@ int ImGuiMain(WindowInit window_init, ImGuiCallsCB imgui_calls, void (*on_graphi
     if((init_flags & NoWindowDecoration) == NoWindowDecoration)
         // Do not display the close/maximize widgets.
         glfwWindowHint(GLFW_DECORATED, GLFW_FALSE);
+    if(offscreen)
+        // The window only provides the context; frames go to a framebuffer of our own.
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
     // Create window with graphics context
-    window = glfwCreateWindow(window_init.width, window_init.height, window_init.title, NULL, NULL);
+    window = NULL;
+    use_gl45_renderer = false;
+#if !__APPLE__
+    if((init_flags & PersistentMappedRenderer) == PersistentMappedRenderer){
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        window = glfwCreateWindow(window_init.width, window_init.height, window_init.title, NULL, NULL);
+        use_gl45_renderer = window != NULL;
+        if (window == NULL){
+            fprintf(stderr, "OpenGL 4.5 is not available, using the OpenGL 3 renderer.\n");
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_ANY_PROFILE);
+        }
+    }
+#endif
     if (window == NULL)
-        return 1;
+        window = glfwCreateWindow(window_init.width, window_init.height, window_init.title, NULL, NULL);
+    if (window == NULL)
+        return fail();
     glfwMakeContextCurrent(window);
     glfwSwapInterval(1); // Enable vsync
+    EndStartupPhase("Create window");
 
     // Initialize OpenGL loader
 #if defined(IMGUI_IMPL_OPENGL_LOADER_GL3W)
@@ -101,25 +362,26 @@ int ImGuiMain(WindowInit window_init, ImGuiCallsCB imgui_calls, void (*on_graphi
     if (err)
     {
         fprintf(stderr, "Failed to initialize OpenGL loader!\n");
-        return 1;
+        return fail();
     }
-
-    // Setup Dear ImGui context
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
-    //io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
-
-    // Setup Dear ImGui style
-    ImGui::StyleColorsDark();
-    //ImGui::StyleColorsClassic();
+    EndStartupPhase("Load OpenGL");
 
     // Setup Platform/Renderer bindings
     ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init(glsl_version);
+    if(use_gl45_renderer)
+        ImGui_ImplOpenGL45_Init();
+    else
+        ImGui_ImplOpenGL3_Init(glsl_version);
+    EndStartupPhase("Init renderer");
 
-    on_graphics_init();
+    if(!deferred_init){
+        on_graphics_init();
+        EndStartupPhase("on_graphics_init");
+        if(window_init.font_cache_file){
+            BuildFonts(io.Fonts, window_init.font_cache_file);
+            EndStartupPhase("Fonts");
+        }
+    }
 
     // Load Fonts
     // - If no fonts are loaded, dear imgui will use the default font. You can also load multiple fonts and use ImGui::PushFont()/PopFont() to select them.
@@ -136,25 +398,90 @@ int ImGuiMain(WindowInit window_init, ImGuiCallsCB imgui_calls, void (*on_graphi
     //ImFont* font = io.Fonts->AddFontFromFileTTF("c:\\Windows\\Fonts\\ArialUni.ttf", 18.0f, NULL, io.Fonts->GetGlyphRangesJapanese());
     //IM_ASSERT(font != NULL);
 
+    // Offscreen, everything is drawn into a renderbuffer of the requested size instead of the window.
+    GLuint offscreen_fbo = 0;
+    GLuint offscreen_color = 0;
+    if(offscreen){
+        glGenRenderbuffers(1, &offscreen_color);
+        glBindRenderbuffer(GL_RENDERBUFFER, offscreen_color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, window_init.width, window_init.height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &offscreen_fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, offscreen_fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreen_color);
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+            fprintf(stderr, "Failed to create the offscreen framebuffer!\n");
+            return fail();
+        }
+        io.DisplaySize = ImVec2(static_cast<float>(window_init.width), static_cast<float>(window_init.height));
+        io.IniFilename = nullptr;
+    }
+    int frame = 0;
+
     // Our state
     bool show_demo_window = (init_flags & ShowDemoWindow) == ShowDemoWindow;
     bool show_another_window = false;
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
+    // When idle, wait for events instead of rendering every frame.
+    // After input a few more frames are rendered, so that ImGui can settle (hover states, windows sizing themselves).
+    bool idle_rendering = (init_flags & IdleRendering) == IdleRendering && !offscreen;
+    constexpr int settle_frames = 3;
+    int active_frames = settle_frames;
+    if(idle_rendering)
+        Redraw::setWaker(glfwPostEmptyEvent);
+    Profiler::setThreadName("Main");
+    // Playback swaps ImGui's allocator, which the font builder is still using until it is joined.
+    if(font_builder.joinable()){
+        font_builder.join();
+        EndStartupPhase("Wait for fonts");
+    }
+    if(!startRecordings(window_init))
+        glfwSetWindowShouldClose(window, 1);
+
     // Main loop
-    while (!glfwWindowShouldClose(window))
+    while (!glfwWindowShouldClose(window) && !(offscreen && window_init.headless_frames > 0 && frame >= window_init.headless_frames))
     {
         // Poll and handle events (inputs, window resize, etc.)
         // You can read the io.WantCaptureMouse, io.WantCaptureKeyboard flags to tell if dear imgui wants to use your inputs.
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-        glfwPollEvents();
+        double timeout = -1.0;
+        if(idle_rendering && active_frames == 0 && !Redraw::takeRequest(timeout)
+            && !FrameCapture::isRecording() && !InputPlayback::isPlaying()){
+            // Input, a Redraw request or the next requested deadline ends the wait.
+            if(timeout < 0.0)
+                glfwWaitEvents();
+            else
+                glfwWaitEventsTimeout(timeout);
+            active_frames = settle_frames;
+        }
+        // Time spent waiting while idle is not part of the frame.
+        Profiler::beginFrame();
+        {
+            PROFILE_ZONE("glfwPollEvents");
+            glfwPollEvents();
+        }
 
         // Start the Dear ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
+        {
+            PROFILE_ZONE("NewFrame");
+            if(FontCache::update(io.Fonts))
+                ReloadFontsTexture();
+            if(use_gl45_renderer)
+                ImGui_ImplOpenGL45_NewFrame();
+            else
+                ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            if(offscreen)
+                // The invisible window may not have the requested size; the framebuffer does.
+                io.DisplaySize = ImVec2(static_cast<float>(window_init.width), static_cast<float>(window_init.height));
+            InputPlayback::processFrame(io);
+            if(InputPlayback::playbackFinished())
+                glfwSetWindowShouldClose(window, 1);
+            ImGui::NewFrame();
+        }
 
         // 1. Show the big demo window (Most of the sample code is in ImGui::ShowDemoWindow()! You can browse its code to learn more about Dear ImGui!).
         if (show_demo_window){
@@ -195,24 +522,99 @@ int ImGuiMain(WindowInit window_init, ImGuiCallsCB imgui_calls, void (*on_graphi
         }
 
         // Call imgui_calls()
-        if (imgui_calls)
+        if (imgui_calls){
+            PROFILE_ZONE("imgui_calls");
             if (imgui_calls() < 0)
                 glfwSetWindowShouldClose(window, 1);
+        }
 
         // Rendering
-        ImGui::Render();
+        {
+            PROFILE_ZONE("Render");
+            ImGui::Render();
+        }
+        DrawCapture::captureFrame(ImGui::GetDrawData());
+        if(idle_rendering){
+            // Keep rendering while something is held or dragged; let the text cursor blink while typing.
+            if(ImGui::IsAnyItemActive() || ImGui::IsAnyMouseDown())
+                active_frames = settle_frames;
+            else if(io.WantTextInput)
+                Redraw::requestIn(0.2);
+            if(active_frames > 0)
+                active_frames--;
+        }
         int display_w, display_h;
         glfwGetFramebufferSize(window, &display_w, &display_h);
+        if(offscreen){
+            display_w = window_init.width;
+            display_h = window_init.height;
+            glBindFramebuffer(GL_FRAMEBUFFER, offscreen_fbo);
+        }
         glViewport(0, 0, display_w, display_h);
         glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
         glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        if(replay){
+            // Wait for the gpu, so that the time measured is the time it took to draw the frame.
+            ImDrawData* draw_data = replay->frame(replay_frame++, io.Fonts->TexID);
+            uint64_t start = Profiler::now();
+            {
+                PROFILE_ZONE("RenderDrawData");
+                RenderDrawData(draw_data);
+                glFinish();
+            }
+            replay_render_times.push_back(Profiler::now() - start);
+        } else {
+            PROFILE_ZONE("RenderDrawData");
+            RenderDrawData(ImGui::GetDrawData());
+        }
+        FrameCapture::captureFrame(display_w, display_h);
+        GPUTexture::DeletionQueue::collect();
 
-        glfwSwapBuffers(window);
+        if(!offscreen){
+            PROFILE_ZONE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        } else {
+            glFlush();
+        }
+        Profiler::endFrame();
+        if(frame == 0){
+            EndStartupPhase("First frame");
+            if(deferred_init){
+                // The window is up; now the work that used to keep it from showing.
+                GPUTexture::SideLoader::create_context();
+                int fonts_before = io.Fonts->Fonts.Size;
+                on_graphics_init();
+                if(!io.FontDefault && io.Fonts->Fonts.Size > fonts_before)
+                    // The default font was built for the first frame and stays Fonts[0]; like without DeferredInit,
+                    // the first font added by on_graphics_init is the one used.
+                    io.FontDefault = io.Fonts->Fonts[fonts_before];
+                if(!io.Fonts->IsBuilt()){
+                    // on_graphics_init added fonts.
+                    BuildFonts(io.Fonts, window_init.font_cache_file);
+                    ReloadFontsTexture();
+                }
+                EndStartupPhase("on_graphics_init");
+            }
+            if((init_flags & ReportStartup) == ReportStartup)
+                PrintStartupPhases();
+        }
+        frame++;
     }
 
     // Cleanup
-    ImGui_ImplOpenGL3_Shutdown();
+    stopRecordings();
+    Redraw::setWaker(nullptr);
+    FrameCapture::shutdown();
+    GPUTexture::DeletionQueue::flush();
+    if(offscreen){
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &offscreen_fbo);
+        glDeleteRenderbuffers(1, &offscreen_color);
+    }
+    if(use_gl45_renderer)
+        ImGui_ImplOpenGL45_Shutdown();
+    else
+        ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
@@ -221,3 +623,55 @@ int ImGuiMain(WindowInit window_init, ImGuiCallsCB imgui_calls, void (*on_graphi
 
     return 0;
 }
+
+int ImGuiReplayDrawData(WindowInit window_init, const char* capture_file, ImGuiInitFlags init_flags)
+{
+    DrawCapture::Replay frames;
+    if(!frames.open(capture_file) || frames.frameCount() == 0){
+        fprintf(stderr, "Failed to open the draw data capture %s!\n", capture_file);
+        return 1;
+    }
+    // Nothing is drawn without a renderer, the demo window would be drawn on top, and the capture should not be re-recorded.
+    init_flags = static_cast<ImGuiInitFlags>(init_flags & ~(Headless | ShowDemoWindow | IdleRendering));
+    window_init.headless_frames = 0;
+    window_init.draw_capture_file = nullptr;
+    window_init.input_record_file = nullptr;
+    window_init.input_playback_file = nullptr;
+
+    replay = &frames;
+    replay_frame = 0;
+    replay_render_times.clear();
+    int result = ImGuiMain(window_init, []{
+        // The frame being built is the one after the frames rendered so far.
+        return replay_frame + 1 >= replay->frameCount() ? -1 : 0;
+    }, []{}, init_flags);
+    replay = nullptr;
+
+    if(result == 0 && !replay_render_times.empty()){
+        uint64_t vertices = 0;
+        uint64_t indices = 0;
+        uint64_t commands = 0;
+        for(size_t i = 0; i < replay_render_times.size(); i++){
+            auto stats = frames.stats(i);
+            vertices += stats.vertices;
+            indices += stats.indices;
+            commands += stats.commands;
+        }
+        std::vector<uint64_t> times = replay_render_times;
+        std::sort(times.begin(), times.end());
+        uint64_t total = 0;
+        for(uint64_t time: times)
+            total += time;
+        size_t count = times.size();
+        printf("Replayed %zu frames of %s\n", count, capture_file);
+        // PersistentMappedRenderer falls back to the OpenGL 3 renderer, so say which one was measured.
+        printf("  renderer: %s\n", use_gl45_renderer ? "ImGuiRendererGL45" : "imgui_impl_opengl3");
+        printf("  per frame: %.1f vertices, %.1f indices, %.1f commands\n",
+            static_cast<double>(vertices) / count, static_cast<double>(indices) / count, static_cast<double>(commands) / count);
+        printf("  render time (ms): mean %.3f, p50 %.3f, p99 %.3f, max %.3f\n",
+            total / 1e6 / count, times[count / 2] / 1e6, times[std::min(count - 1, count * 99 / 100)] / 1e6, times.back() / 1e6);
+        printf("  throughput: %.1f M vertices/s\n", total > 0 ? vertices * 1e3 / total : 0.0);
+    }
+    replay_render_times.clear();
+    return result;
+}
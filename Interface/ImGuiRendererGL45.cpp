@@ -0,0 +1,340 @@
+/**
+ * Unlike imgui_impl_opengl3, which re-specifies its buffers with glBufferData and draws every command on its own:
+ *  - Vertices and indices are written into buffers that stay mapped. The buffers are split in three regions
+ *    used in turn, each guarded by a fence, so the cpu never writes into what the gpu is still reading.
+ *  - Consecutive commands with the same texture and clip rect are drawn with one glMultiDrawElementsBaseVertex.
+ *  - The pipeline state is set once per frame, instead of being saved and restored around every frame.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <GL/gl3w.h>
+#include "ImGuiRendererGL45.hpp"
+#include "../tools/Profiler/Profiler.hpp"
+
+namespace {
+    constexpr int region_count = 3;
+
+    struct Region {
+        GLsync fence = nullptr;
+    };
+
+    struct RendererData {
+        GLuint program = 0;
+        GLint projection_location = -1;
+        GLuint vao = 0;
+        GLuint vertex_buffer = 0;
+        GLuint index_buffer = 0;
+        GLuint font_texture = 0;
+
+        // Capacity of one region, in vertices and indices.
+        size_t vertex_capacity = 0;
+        size_t index_capacity = 0;
+        ImDrawVert* vertices = nullptr;
+        ImDrawIdx* indices = nullptr;
+        Region regions[region_count];
+        int region = 0;
+
+        // The batch being accumulated for glMultiDrawElementsBaseVertex.
+        std::vector<GLsizei> counts;
+        std::vector<const void*> offsets;
+        std::vector<GLint> base_vertices;
+    };
+
+    static RendererData* renderer = nullptr;
+
+    const char* vertex_shader_source =
+        "#version 450 core\n"
+        "layout (location = 0) in vec2 Position;\n"
+        "layout (location = 1) in vec2 UV;\n"
+        "layout (location = 2) in vec4 Color;\n"
+        "uniform mat4 ProjMtx;\n"
+        "out vec2 Frag_UV;\n"
+        "out vec4 Frag_Color;\n"
+        "void main()\n"
+        "{\n"
+        "    Frag_UV = UV;\n"
+        "    Frag_Color = Color;\n"
+        "    gl_Position = ProjMtx * vec4(Position.xy, 0, 1);\n"
+        "}\n";
+
+    const char* fragment_shader_source =
+        "#version 450 core\n"
+        "in vec2 Frag_UV;\n"
+        "in vec4 Frag_Color;\n"
+        "layout (binding = 0) uniform sampler2D Texture;\n"
+        "layout (location = 0) out vec4 Out_Color;\n"
+        "void main()\n"
+        "{\n"
+        "    Out_Color = Frag_Color * texture(Texture, Frag_UV.st);\n"
+        "}\n";
+
+    GLuint compileShader(GLenum type, const char* source){
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        GLint status = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if(status == GL_FALSE){
+            char log[1024];
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            fprintf(stderr, "ImGuiRendererGL45: failed to compile a shader: %s\n", log);
+        }
+        return shader;
+    }
+
+    void createFontTexture(){
+        ImGuiIO& io = ImGui::GetIO();
+        unsigned char* pixels;
+        int width, height;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+        glGenTextures(1, &renderer->font_texture);
+        glBindTexture(GL_TEXTURE_2D, renderer->font_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        io.Fonts->TexID = reinterpret_cast<ImTextureID>(static_cast<intptr_t>(renderer->font_texture));
+    }
+
+    void waitForAllRegions(){
+        for(Region& region: renderer->regions){
+            if(region.fence){
+                glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+                glDeleteSync(region.fence);
+                region.fence = nullptr;
+            }
+        }
+    }
+
+    void destroyBuffers(){
+        if(!renderer->vertex_buffer)
+            return;
+        waitForAllRegions();
+        glBindBuffer(GL_ARRAY_BUFFER, renderer->vertex_buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, renderer->index_buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDeleteBuffers(1, &renderer->vertex_buffer);
+        glDeleteBuffers(1, &renderer->index_buffer);
+        renderer->vertex_buffer = 0;
+        renderer->index_buffer = 0;
+        renderer->vertices = nullptr;
+        renderer->indices = nullptr;
+    }
+
+    /**
+     * Make the regions big enough for a frame. Growing has to wait for the gpu, so the capacity is doubled each time.
+     */
+    void reserveBuffers(size_t vertex_count, size_t index_count){
+        if(vertex_count <= renderer->vertex_capacity && index_count <= renderer->index_capacity)
+            return;
+        size_t vertex_capacity = renderer->vertex_capacity ? renderer->vertex_capacity : 64 * 1024;
+        size_t index_capacity = renderer->index_capacity ? renderer->index_capacity : 128 * 1024;
+        while(vertex_capacity < vertex_count)
+            vertex_capacity *= 2;
+        while(index_capacity < index_count)
+            index_capacity *= 2;
+        destroyBuffers();
+        renderer->vertex_capacity = vertex_capacity;
+        renderer->index_capacity = index_capacity;
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLsizeiptr vertex_bytes = region_count * vertex_capacity * sizeof(ImDrawVert);
+        GLsizeiptr index_bytes = region_count * index_capacity * sizeof(ImDrawIdx);
+
+        glBindVertexArray(renderer->vao);
+        glGenBuffers(1, &renderer->vertex_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, renderer->vertex_buffer);
+        glBufferStorage(GL_ARRAY_BUFFER, vertex_bytes, nullptr, flags);
+        renderer->vertices = static_cast<ImDrawVert*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, vertex_bytes, flags));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), reinterpret_cast<void*>(IM_OFFSETOF(ImDrawVert, pos)));
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), reinterpret_cast<void*>(IM_OFFSETOF(ImDrawVert, uv)));
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), reinterpret_cast<void*>(IM_OFFSETOF(ImDrawVert, col)));
+
+        glGenBuffers(1, &renderer->index_buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, renderer->index_buffer);
+        glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, index_bytes, nullptr, flags);
+        renderer->indices = static_cast<ImDrawIdx*>(glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, index_bytes, flags));
+        glBindVertexArray(0);
+    }
+
+    void createDeviceObjects(){
+        GLuint vertex_shader = compileShader(GL_VERTEX_SHADER, vertex_shader_source);
+        GLuint fragment_shader = compileShader(GL_FRAGMENT_SHADER, fragment_shader_source);
+        renderer->program = glCreateProgram();
+        glAttachShader(renderer->program, vertex_shader);
+        glAttachShader(renderer->program, fragment_shader);
+        glLinkProgram(renderer->program);
+        glDetachShader(renderer->program, vertex_shader);
+        glDetachShader(renderer->program, fragment_shader);
+        glDeleteShader(vertex_shader);
+        glDeleteShader(fragment_shader);
+        renderer->projection_location = glGetUniformLocation(renderer->program, "ProjMtx");
+
+        glGenVertexArrays(1, &renderer->vao);
+        reserveBuffers(1, 1);
+        createFontTexture();
+    }
+
+    void setupRenderState(ImDrawData* draw_data, int fb_width, int fb_height){
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_SCISSOR_TEST);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glViewport(0, 0, fb_width, fb_height);
+
+        float L = draw_data->DisplayPos.x;
+        float R = draw_data->DisplayPos.x + draw_data->DisplaySize.x;
+        float T = draw_data->DisplayPos.y;
+        float B = draw_data->DisplayPos.y + draw_data->DisplaySize.y;
+        const float projection[4][4] = {
+            { 2.0f/(R-L),   0.0f,         0.0f,   0.0f },
+            { 0.0f,         2.0f/(T-B),   0.0f,   0.0f },
+            { 0.0f,         0.0f,        -1.0f,   0.0f },
+            { (R+L)/(L-R),  (T+B)/(B-T),  0.0f,   1.0f },
+        };
+        glUseProgram(renderer->program);
+        glUniformMatrix4fv(renderer->projection_location, 1, GL_FALSE, &projection[0][0]);
+        glBindVertexArray(renderer->vao);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void flushBatch(){
+        if(renderer->counts.empty())
+            return;
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, renderer->counts.data(),
+            sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+            renderer->offsets.data(), static_cast<GLsizei>(renderer->counts.size()), renderer->base_vertices.data());
+        renderer->counts.clear();
+        renderer->offsets.clear();
+        renderer->base_vertices.clear();
+    }
+}
+
+bool ImGui_ImplOpenGL45_Init(){
+    ImGuiIO& io = ImGui::GetIO();
+    io.BackendRendererName = "easy_imgui_opengl45";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+    renderer = new RendererData();
+    return true;
+}
+
+void ImGui_ImplOpenGL45_Shutdown(){
+    if(!renderer)
+        return;
+    if(renderer->program){
+        destroyBuffers();
+        glDeleteVertexArrays(1, &renderer->vao);
+        glDeleteProgram(renderer->program);
+        ImGui_ImplOpenGL45_DestroyFontsTexture();
+    }
+    delete renderer;
+    renderer = nullptr;
+}
+
+void ImGui_ImplOpenGL45_CreateFontsTexture(){
+    if(renderer->program)
+        createFontTexture();
+}
+
+void ImGui_ImplOpenGL45_DestroyFontsTexture(){
+    if(!renderer->font_texture)
+        return;
+    glDeleteTextures(1, &renderer->font_texture);
+    renderer->font_texture = 0;
+    ImGui::GetIO().Fonts->TexID = 0;
+}
+
+void ImGui_ImplOpenGL45_NewFrame(){
+    if(!renderer->program)
+        createDeviceObjects();
+}
+
+void ImGui_ImplOpenGL45_RenderDrawData(ImDrawData* draw_data){
+    int fb_width = static_cast<int>(draw_data->DisplaySize.x * draw_data->FramebufferScale.x);
+    int fb_height = static_cast<int>(draw_data->DisplaySize.y * draw_data->FramebufferScale.y);
+    if(fb_width <= 0 || fb_height <= 0 || draw_data->CmdListsCount == 0)
+        return;
+
+    reserveBuffers(static_cast<size_t>(draw_data->TotalVtxCount), static_cast<size_t>(draw_data->TotalIdxCount));
+    renderer->region = (renderer->region + 1) % region_count;
+    Region& region = renderer->regions[renderer->region];
+    if(region.fence){
+        // Three frames back; normally long done.
+        PROFILE_ZONE("Wait for region");
+        glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+        glDeleteSync(region.fence);
+        region.fence = nullptr;
+    }
+
+    setupRenderState(draw_data, fb_width, fb_height);
+    ImVec2 clip_off = draw_data->DisplayPos;
+    ImVec2 clip_scale = draw_data->FramebufferScale;
+    size_t vertex_base = renderer->region * renderer->vertex_capacity;
+    size_t index_base = renderer->region * renderer->index_capacity;
+
+    GLuint bound_texture = 0;
+    ImVec4 scissor{-1.0f, -1.0f, -1.0f, -1.0f};
+    bool first_batch = true;
+    for(int n = 0; n < draw_data->CmdListsCount; n++){
+        const ImDrawList* cmd_list = draw_data->CmdLists[n];
+        memcpy(renderer->vertices + vertex_base, cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+        memcpy(renderer->indices + index_base, cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+
+        for(const ImDrawCmd& cmd: cmd_list->CmdBuffer){
+            if(cmd.UserCallback){
+                flushBatch();
+                if(cmd.UserCallback == ImDrawCallback_ResetRenderState)
+                    setupRenderState(draw_data, fb_width, fb_height);
+                else
+                    cmd.UserCallback(cmd_list, &cmd);
+                first_batch = true;
+                continue;
+            }
+            ImVec4 clip_rect{
+                (cmd.ClipRect.x - clip_off.x) * clip_scale.x,
+                (cmd.ClipRect.y - clip_off.y) * clip_scale.y,
+                (cmd.ClipRect.z - clip_off.x) * clip_scale.x,
+                (cmd.ClipRect.w - clip_off.y) * clip_scale.y
+            };
+            if(clip_rect.x >= fb_width || clip_rect.y >= fb_height || clip_rect.z < 0.0f || clip_rect.w < 0.0f)
+                continue;
+
+            GLuint texture = static_cast<GLuint>(reinterpret_cast<intptr_t>(cmd.TextureId));
+            bool same_clip = clip_rect.x == scissor.x && clip_rect.y == scissor.y && clip_rect.z == scissor.z && clip_rect.w == scissor.w;
+            if(first_batch || texture != bound_texture || !same_clip){
+                flushBatch();
+                if(first_batch || texture != bound_texture)
+                    glBindTexture(GL_TEXTURE_2D, texture);
+                if(first_batch || !same_clip)
+                    glScissor(static_cast<int>(clip_rect.x), static_cast<int>(fb_height - clip_rect.w),
+                        static_cast<int>(clip_rect.z - clip_rect.x), static_cast<int>(clip_rect.w - clip_rect.y));
+                bound_texture = texture;
+                scissor = clip_rect;
+                first_batch = false;
+            }
+            renderer->counts.push_back(static_cast<GLsizei>(cmd.ElemCount));
+            renderer->offsets.push_back(reinterpret_cast<const void*>((index_base + cmd.IdxOffset) * sizeof(ImDrawIdx)));
+            renderer->base_vertices.push_back(static_cast<GLint>(vertex_base + cmd.VtxOffset));
+        }
+        vertex_base += cmd_list->VtxBuffer.Size;
+        index_base += cmd_list->IdxBuffer.Size;
+    }
+    flushBatch();
+    region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // Leave the state the way the next glClear() expects it.
+    glDisable(GL_SCISSOR_TEST);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
@@ -0,0 +1,14 @@
+#pragma once
+/**
+ * An OpenGL 4.5 renderer for ImGui, used by ImGuiMain with the PersistentMappedRenderer flag.
+ * Same interface as imgui_impl_opengl3.
+ */
+#include "imgui.h"
+
+bool ImGui_ImplOpenGL45_Init();
+void ImGui_ImplOpenGL45_Shutdown();
+void ImGui_ImplOpenGL45_NewFrame();
+void ImGui_ImplOpenGL45_RenderDrawData(ImDrawData* draw_data);
+// Upload the font atlas again, e.g. after it was rebuilt.
+void ImGui_ImplOpenGL45_CreateFontsTexture();
+void ImGui_ImplOpenGL45_DestroyFontsTexture();
@@ -0,0 +1,50 @@
+/**
+ * 2020 Jonathan Mendez
+ */
+#include <cstdio>
+#include <cstring>
+
+#include "easy_imgui.h"
+
+/**
+ * Render the frames of a draw data capture (see DrawCapture) and print how long rendering took.
+ * Only the renderer runs, so the times do not depend on the UI code that built the frames.
+ * By default the frames are rendered by imgui_impl_opengl3 and then by ImGuiRendererGL45, to compare the two.
+ *
+ * draw-replay-bench <capture file> [--gl3 | --gl45] [--offscreen]
+ *   --gl3        Only render with imgui_impl_opengl3.
+ *   --gl45       Only render with ImGuiRendererGL45 (PersistentMappedRenderer).
+ *   --offscreen  Render into an offscreen framebuffer, e.g. under Mesa's llvmpipe without a display.
+ */
+int main(int argc, char** argv){
+    const char* capture_file = nullptr;
+    int init_flags = 0;
+    bool run_gl3 = true;
+    bool run_gl45 = true;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--offscreen") == 0)
+            init_flags |= Offscreen;
+        else if(strcmp(argv[i], "--gl3") == 0)
+            run_gl45 = false;
+        else if(strcmp(argv[i], "--gl45") == 0)
+            run_gl3 = false;
+        else if(argv[i][0] != '-' && !capture_file)
+            capture_file = argv[i];
+        else {
+            fprintf(stderr, "Unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if(!capture_file || (!run_gl3 && !run_gl45)){
+        fprintf(stderr, "Usage: %s <capture file> [--gl3 | --gl45] [--offscreen]\n", argv[0]);
+        return 1;
+    }
+
+    WindowInit window_init{.title = "Draw replay benchmark", .width = 1280, .height = 720};
+    int result = 0;
+    if(run_gl3)
+        result = ImGuiReplayDrawData(window_init, capture_file, static_cast<ImGuiInitFlags>(init_flags));
+    if(run_gl45 && result == 0)
+        result = ImGuiReplayDrawData(window_init, capture_file, static_cast<ImGuiInitFlags>(init_flags | PersistentMappedRenderer));
+    return result;
+}
@@ -0,0 +1,93 @@
+/**
+ * 2020 Jonathan Mendez
+ */
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <vector>
+
+#define EASY_DIREXPLORER_UI
+#define EASY_PROFILER
+#include "easy_imgui.h"
+
+/**
+ * Frame times of ListDirectory with 1k, 100k and 1M synthetic entries, run in Headless mode.
+ * Only the rows in view are submitted, so the frame time should not grow with the number of entries.
+ */
+namespace {
+    constexpr size_t entry_counts[] = {1000, 100000, 1000000};
+    constexpr int warmup_frames = 10;
+    constexpr int measured_frames = 300;
+
+    ImGui::DirectoryExplorer::DirectoryCtx dir_ctx;
+    std::filesystem::path bench_dir;
+    size_t current_count = 0;
+    int frame = 0;
+    uint64_t frame_start = 0;
+    std::vector<uint64_t> frame_times;
+
+    void loadEntries(size_t count){
+        DirSnapshot snapshot;
+        snapshot.clear(bench_dir);
+        char name[32];
+        for(size_t i = 0; i < count; i++){
+            snprintf(name, sizeof(name), "file_%07zu.txt", i);
+            snapshot.append(name, DirEntryType_RegularFile);
+        }
+        dir_ctx.explorer->showSnapshot(std::move(snapshot));
+    }
+
+    void printFrameTimes(size_t count){
+        std::sort(frame_times.begin(), frame_times.end());
+        uint64_t total = 0;
+        for(uint64_t time: frame_times)
+            total += time;
+        auto ms = [](uint64_t ns){ return static_cast<double>(ns) / 1e6; };
+        printf("%8zu entries: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", count,
+            ms(total / frame_times.size()), ms(frame_times[frame_times.size() / 2]),
+            ms(frame_times[frame_times.size() * 99 / 100]), ms(frame_times.back()));
+    }
+
+    int benchFrame(){
+        // The time since the last call covers a whole frame, from NewFrame() to Render().
+        uint64_t now = Profiler::now();
+        if(frame > warmup_frames)
+            frame_times.push_back(now - frame_start);
+        frame_start = now;
+        if(frame == warmup_frames + measured_frames){
+            printFrameTimes(entry_counts[current_count]);
+            if(++current_count == std::size(entry_counts))
+                return -1;
+            loadEntries(entry_counts[current_count]);
+            frame_times.clear();
+            frame = 0;
+        }
+        frame++;
+
+        ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+        ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
+        ImGui::Begin("ListDirectory", nullptr, ImGuiWindowFlags_NoDecoration);
+        // Scroll every frame, so the rows in view change as they would while the user scrolls.
+        ImGui::SetScrollY(frame * 10.0f * ImGui::GetTextLineHeightWithSpacing());
+        ImGui::DirectoryExplorer::ListDirectory(dir_ctx);
+        ImGui::End();
+        return 0;
+    }
+}
+
+int main(){
+    // The explorer watches a real directory, so give it an empty one.
+    bench_dir = std::filesystem::temp_directory_path() / "easy-imgui-list-directory-bench";
+    std::filesystem::create_directories(bench_dir);
+    dir_ctx = ImGui::DirectoryExplorer::NewDirExplorer("ListDirectoryBench", bench_dir.string());
+    loadEntries(entry_counts[0]);
+
+    WindowInit window_init{.title = "ListDirectory benchmark", .width = 1280, .height = 720};
+    int result = ImGuiMain(window_init, benchFrame, nullptr, Headless);
+
+    dir_ctx = {};
+    std::error_code ec;
+    std::filesystem::remove_all(bench_dir, ec);
+    return result;
+}
@@ -12,6 +12,30 @@
 #include "tools/ImageLoad/ImageLoad.hpp"
 #endif
 
+#ifdef EASY_FONTCACHE
+#include "tools/FontCache/FontCache.hpp"
+#endif
+
+#ifdef EASY_FRAMECAPTURE
+#include "tools/FrameCapture/FrameCapture.hpp"
+#endif
+
+#ifdef EASY_DRAWCAPTURE
+#include "tools/DrawCapture/DrawCapture.hpp"
+#endif
+
+#ifdef EASY_INPUTPLAYBACK
+#include "tools/InputPlayback/InputPlayback.hpp"
+#endif
+
+#ifdef EASY_PROFILER
+#include "tools/Profiler/Profiler.hpp"
+#endif
+
+#ifdef EASY_REDRAW
+#include "tools/Redraw/Redraw.hpp"
+#endif
+
 #ifdef EASY_DIREXPLORER_UI
 #include "tools/DirExplorer/ImGuiDirExplorer.hpp"
 #endif
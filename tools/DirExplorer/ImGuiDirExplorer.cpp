@@ -1,26 +1,83 @@
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <stack>
 
-#ifdef WIN32
-constexpr auto& strtok_r = strtok_s;
-#endif
-
 #include "ImGuiDirExplorer.hpp"
 #include "dir_explorer.hpp"
+#include "dir_filter.hpp"
+#include "dir_index.hpp"
+#include "dir_search.hpp"
+#include "dir_thumbnails.hpp"
 
 #include "imgui.h"
 #include "misc/cpp/imgui_stdlib.h"
 
 #include "../tools/ui_helpers.hpp"
+#include "../Redraw/Redraw.hpp"
 
 namespace ImGui {
     namespace DirectoryExplorer {
+        /**
+         * The search box's query and what it searches: the snapshot, or an index of the whole subtree.
+         */
+        struct SearchState {
+            std::string query;
+            bool subfolders = false;
+            DirSearch search;
+            // What the search's candidates were taken from.
+            uint64_t generation = 0;
+            bool searching_snapshot = false;
+            std::shared_ptr<const DirIndex> index;
+            bool searching_index = false;
+            DirIndexer indexer;
+            std::filesystem::path indexing_root;
+        };
+
+        /**
+         * The entries ListDirectory shows, kept until the snapshot or the filter changes.
+         */
+        struct ListState {
+            enum SortColumn {
+                SortColumn_None,
+                SortColumn_Name,
+                SortColumn_Size,
+                SortColumn_Modified,
+                SortColumn_Type
+            };
+
+            uint64_t generation = 0;
+            DirFilter filter;
+            // Bit i is set when entry i of the snapshot passes the filter.
+            std::vector<uint64_t> matches;
+            std::vector<uint32_t> rows;
+
+            SortColumn sort_column = SortColumn_None;
+            bool sort_descending = false;
+            // What the rows are currently sorted by, so they are only sorted again when something changes.
+            SortColumn sorted_column = SortColumn_None;
+            bool sorted_descending = false;
+            uint64_t sorted_metadata_generation = 0;
+
+            SearchState search;
+
+            // Created the first time the grid is shown, and cleared when the directory changes.
+            std::unique_ptr<ThumbnailCache> thumbnails;
+            int thumbnail_size = 0;
+            std::string thumbnails_dir;
+        };
+
         DirectoryCtx NewDirExplorer(const std::string& context_name, const std::string& start_path){
-            return {
-                .explorer{std::make_shared<DirExplorer>(context_name, start_path)}
+            DirectoryCtx dir_ctx{
+                .explorer{std::make_shared<DirExplorer>(context_name, start_path)},
+                .list{std::make_shared<ListState>()}
             };
+            // Changes seen by the watcher have to be shown even when nothing else asks for a frame.
+            dir_ctx.explorer->setChangeCallback(Redraw::request);
+            return dir_ctx;
         }
 
         bool Begin(DirectoryCtx dir_ctx){
@@ -81,56 +138,411 @@ namespace ImGui {
             ImGui::PopItemWidth();
         }
 
+        /**
+         * Search the directory by name as you type. With "Subfolders" ticked the whole subtree is indexed in the background
+         * and searched instead; the index is kept in the user's cache directory so that the next run only has to refresh it.
+         */
+        void ShowSearchBar(DirectoryCtx dir_ctx, float width){
+            if(!dir_ctx.list)
+                return;
+            auto& search = dir_ctx.list->search;
+            float checkbox_width = ImGui::GetFrameHeight() + ImGui::GetStyle().ItemInnerSpacing.x + ImGui::CalcTextSize("Subfolders").x;
+            if(width < 0.0f)
+                width = ImGui::GetContentRegionAvail().x + width + 1.0f;
+            ImGui::PushItemWidth(width - checkbox_width - ImGui::GetStyle().ItemSpacing.x);
+            ImGui::InputTextWithHint("##search", "Search", &search.query);
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            ImGui::Checkbox("Subfolders", &search.subfolders);
+        }
+
+        /**
+         * A directory only the current user can write to, for the subtree indexes; empty if there is none.
+         * The shared temporary directory is not used, since another user could place an index there.
+         */
+        static std::filesystem::path indexCacheDirectory(){
+            std::filesystem::path dir;
+#ifdef _WIN32
+            if(const char* local_app_data = std::getenv("LOCALAPPDATA"))
+                dir = std::filesystem::path(local_app_data) / "imgui-dir-index";
+#else
+            if(const char* cache_home = std::getenv("XDG_CACHE_HOME"); cache_home && cache_home[0] == '/')
+                dir = std::filesystem::path(cache_home) / "imgui-dir-index";
+            else if(const char* home = std::getenv("HOME"); home && home[0])
+                dir = std::filesystem::path(home) / ".cache" / "imgui-dir-index";
+#endif
+            if(dir.empty())
+                return {};
+            std::error_code ec;
+            std::filesystem::create_directories(dir, ec);
+            if(ec)
+                return {};
+            std::filesystem::permissions(dir, std::filesystem::perms::owner_all, std::filesystem::perm_options::replace, ec);
+            return dir;
+        }
+
+        /**
+         * The candidates are views into the snapshot or the index, so they have to go before what they point into.
+         */
+        static void dropCandidates(SearchState& search){
+            search.search.setCandidates(0, [](size_t){ return std::string_view{}; });
+            search.searching_snapshot = false;
+            search.searching_index = false;
+        }
+
+        /**
+         * Keep the search's candidates in step with the snapshot or the subtree index, then run the query.
+         */
+        static void updateSearch(SearchState& search, DirExplorer& explorer){
+            std::filesystem::path root{explorer.getCurrentDir()};
+            const DirSnapshot& snapshot = explorer.getSnapshot();
+            // Navigating or a removal can free the names of the snapshot, and every change moves its generation on.
+            if(search.searching_snapshot && (search.subfolders || search.generation != snapshot.getGeneration()))
+                dropCandidates(search);
+            if(search.subfolders){
+                if(search.indexing_root != root){
+                    search.indexer.cancel();
+                    dropCandidates(search);
+                    search.index.reset();
+                    search.indexing_root = root;
+                    std::filesystem::path index_file;
+                    auto cache_dir = indexCacheDirectory();
+                    if(!cache_dir.empty())
+                        index_file = cache_dir / ("dir_index_" + std::to_string(std::hash<std::string>{}(root.string())) + ".bin");
+                    search.indexer = DirIndexer::start(root, index_file);
+                }
+                if(auto index = search.indexer.takeIndex()){
+                    search.index = std::move(index);
+                    search.searching_index = false;
+                }
+                // Also when Subfolders is ticked again and the index of this root is already there.
+                if(search.index && !search.searching_index){
+                    // Node 0 is the root itself.
+                    search.search.setCandidates(search.index->size() - 1, [&](size_t i){
+                        return search.index->name(static_cast<uint32_t>(i + 1));
+                    });
+                    search.searching_index = true;
+                }
+            } else if(!search.searching_snapshot){
+                search.search.setCandidates(snapshot.size(), [&](size_t i){ return snapshot.nameView(i); });
+                search.generation = snapshot.getGeneration();
+                search.searching_snapshot = true;
+                search.searching_index = false;
+            }
+            // Nothing is searched while the index of the root is still being built.
+            if(!search.searching_snapshot && !search.searching_index)
+                return;
+            search.search.update(search.query);
+        }
+
+        /**
+         * Show the best matches of the search instead of the listing. Returns false if there is no query.
+         */
+        static bool listSearchResults(DirectoryCtx& dir_ctx, ListState& list){
+            auto& search = list.search;
+            if(search.query.empty())
+                return false;
+            updateSearch(search, *dir_ctx.explorer);
+            if(search.subfolders && !search.searching_index){
+                ImGui::TextDisabled("Indexing... %zu entries", search.indexer.entriesIndexed());
+                return true;
+            }
+            ImGui::TextDisabled("%zu matches", search.search.matchCount());
+
+            // Results can be skipped by the filter, so they are not clipped.
+            const DirSnapshot& snapshot = dir_ctx.explorer->getSnapshot();
+            std::filesystem::path clicked;
+            bool clicked_directory = false;
+            for(uint32_t result: search.search.results()){
+                if(search.searching_index){
+                    uint32_t node = result + 1;
+                    bool is_directory = search.index->isDirectory(node);
+                    if(!list.filter.passes(search.index->name(node), is_directory))
+                        continue;
+                    auto path = search.index->path(node);
+                    auto relative = path.lexically_relative(search.index->getRoot()).string();
+                    if(ImGui::Selectable(relative.c_str())){
+                        clicked = path;
+                        clicked_directory = is_directory;
+                    }
+                    if(ImGui::IsItemActive())
+                        ImGui::DragDrop::BeginSource(path);
+                } else {
+                    if(result >= snapshot.size() || !(list.matches[result / 64] & (uint64_t(1) << (result % 64))))
+                        continue;
+                    if(ImGui::Selectable(snapshot.name(result))){
+                        clicked = snapshot.path(result);
+                        clicked_directory = snapshot.isDirectory(result);
+                    }
+                    if(ImGui::IsItemActive())
+                        ImGui::DragDrop::BeginSource(snapshot.path(result));
+                }
+            }
+
+            if(!clicked.empty()){
+                if(clicked_directory){
+                    dir_ctx.explorer->swapDir(clicked.string());
+                    search.query.clear();
+                } else {
+                    dir_ctx.explorer->selectChild(clicked.string());
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Match the filter against the snapshot. Only done again when the snapshot or the filter list changes;
+         * the filter list is only compiled again when it changes.
+         */
+        static void updateRows(ListState& list, const DirSnapshot& snapshot, const char* filter_list){
+            bool filter_changed = list.filter.getSource() != filter_list;
+            if(!filter_changed && list.generation == snapshot.getGeneration())
+                return;
+            if(filter_changed)
+                list.filter = DirFilter(filter_list);
+            list.generation = snapshot.getGeneration();
+
+            list.filter.match(snapshot, list.matches);
+            list.rows.clear();
+            for(size_t entry = 0; entry < snapshot.size(); entry++){
+                if(list.matches[entry / 64] & (uint64_t(1) << (entry % 64)))
+                    list.rows.push_back(static_cast<uint32_t>(entry));
+            }
+            // The rows are in snapshot order again.
+            list.sorted_column = ListState::SortColumn_None;
+        }
+
+        /**
+         * Sort the rows by the chosen column, directories first.
+         * The sort is stable and reads the snapshot's columns directly, so it is cheap to run again
+         * when metadata arrives or the order is flipped.
+         */
+        static void sortRows(ListState& list, const DirSnapshot& snapshot){
+            if(list.sort_column == ListState::SortColumn_None){
+                if(list.sorted_column != ListState::SortColumn_None)
+                    list.generation = 0; // Go back to snapshot order.
+                return;
+            }
+            bool uses_metadata = list.sort_column == ListState::SortColumn_Size || list.sort_column == ListState::SortColumn_Modified;
+            if(list.sorted_column == list.sort_column
+                && list.sorted_descending == list.sort_descending
+                && (!uses_metadata || list.sorted_metadata_generation == snapshot.getMetadataGeneration())
+            )
+                return;
+            list.sorted_column = list.sort_column;
+            list.sorted_descending = list.sort_descending;
+            list.sorted_metadata_generation = snapshot.getMetadataGeneration();
+
+            auto lessName = [&](uint32_t a, uint32_t b){
+                auto name_a = snapshot.nameView(a);
+                auto name_b = snapshot.nameView(b);
+                return std::lexicographical_compare(
+                    name_a.begin(), name_a.end(), name_b.begin(), name_b.end(),
+                    [](char x, char y){
+                        return tolower(static_cast<unsigned char>(x)) < tolower(static_cast<unsigned char>(y));
+                    }
+                );
+            };
+
+            // Rank the extensions once so that sorting by type compares integers.
+            std::vector<uint32_t> extension_rank;
+            if(list.sort_column == ListState::SortColumn_Type){
+                std::vector<uint32_t> ids(snapshot.extensionCount());
+                for(uint32_t id = 0; id < ids.size(); id++)
+                    ids[id] = id;
+                std::sort(ids.begin(), ids.end(), [&](uint32_t a, uint32_t b){
+                    return snapshot.extension(a) < snapshot.extension(b);
+                });
+                extension_rank.resize(ids.size());
+                for(uint32_t rank = 0; rank < ids.size(); rank++)
+                    extension_rank[ids[rank]] = rank;
+            }
+
+            bool descending = list.sort_descending;
+            auto column = list.sort_column;
+            std::stable_sort(list.rows.begin(), list.rows.end(), [&](uint32_t a, uint32_t b){
+                bool dir_a = snapshot.isDirectory(a);
+                bool dir_b = snapshot.isDirectory(b);
+                if(dir_a != dir_b)
+                    return dir_a;
+                if(descending)
+                    std::swap(a, b);
+                switch(column){
+                    case ListState::SortColumn_Size:
+                        if(snapshot.fileSize(a) != snapshot.fileSize(b))
+                            return snapshot.fileSize(a) < snapshot.fileSize(b);
+                        break;
+                    case ListState::SortColumn_Modified:
+                        if(snapshot.modifiedTime(a) != snapshot.modifiedTime(b))
+                            return snapshot.modifiedTime(a) < snapshot.modifiedTime(b);
+                        break;
+                    case ListState::SortColumn_Type:
+                        if(snapshot.extensionId(a) != snapshot.extensionId(b))
+                            return extension_rank[snapshot.extensionId(a)] < extension_rank[snapshot.extensionId(b)];
+                        break;
+                    default:
+                        break;
+                }
+                return lessName(a, b);
+            });
+        }
+
+        /**
+         * Read a directory ahead of time while its item is hovered or has keyboard focus, since it is likely to be visited next.
+         */
+        static void prefetchIfNext(DirectoryCtx& dir_ctx, const DirSnapshot& snapshot, size_t entry, bool probe_images = false){
+            if(snapshot.isDirectory(entry) && (ImGui::IsItemHovered() || ImGui::IsItemFocused()))
+                dir_ctx.explorer->prefetch(snapshot.path(entry).string(), probe_images);
+        }
+
+        /**
+         * Visit a directory or select a file.
+         */
+        static void openEntry(DirectoryCtx& dir_ctx, const DirSnapshot& snapshot, size_t entry){
+            if(entry == DirSnapshot::npos)
+                return;
+            if(snapshot.isDirectory(entry))
+                dir_ctx.explorer->swapDir(snapshot.path(entry).string());
+            else if(snapshot.isRegularFile(entry))
+                dir_ctx.explorer->selectChild(snapshot.path(entry).string());
+        }
+
         /**
          * A filter list denotes the file extensions to list (seperated by commas.)
+         * Wildcard and regular expression tokens are also accepted; see DirFilter.
+         * Only the rows that are scrolled into view are submitted, so the cost of a frame does not depend on the size of the directory.
          */
         void ListDirectory(DirectoryCtx dir_ctx, const char* filter_list){
-            static const char * filter_seperator = ",";
-
-            int size_tok_buf = strlen(filter_list) + 1;
-            auto filter_tok{std::make_unique<char[]>(size_tok_buf)};
-            memset(filter_tok.get(), 0, size_tok_buf);
-            strncpy(filter_tok.get(), filter_list, size_tok_buf - 1);
-            int i;
-            for(char* i_strtok = filter_tok.get(), i=0;
-                filter_tok[i] != '\0';
-                i += strlen(i_strtok), i_strtok = nullptr
-            ){
-                i_strtok = strtok_r(i_strtok, filter_seperator, &i_strtok);
-            }
-
-            for(auto dir_entry : *dir_ctx.explorer){
-                auto _excludeDirEntry = [&](){
-                    bool filter_match = false;
-                    char* it = filter_tok.get();
-                    while(*it){
-                        if(dir_entry.path().extension().string().compare(it) == 0){
-                            filter_match = true;
-                            break;
-                        }
-                        it = it + strlen(it) + 1; // Get the next filter token.
-                    }
-                    // If there exists some filter && a filter was not matched.
-                    return !(size_tok_buf < 2) && !filter_match;
-                };
+            dir_ctx.explorer->poll();
+            if(dir_ctx.explorer->isLoading())
+                ImGui::TextDisabled("Loading... %zu entries", dir_ctx.explorer->loadedCount());
 
-                if(!dir_entry.is_directory() && _excludeDirEntry()){
-                    continue;
+            ListState uncached;
+            ListState& list = dir_ctx.list ? *dir_ctx.list : uncached;
+            const DirSnapshot& snapshot = dir_ctx.explorer->getSnapshot();
+            updateRows(list, snapshot, filter_list);
+            if(listSearchResults(dir_ctx, list))
+                return;
+
+            // Acting on a click is left until the clipper is done, since it can replace the snapshot.
+            size_t clicked = DirSnapshot::npos;
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(list.rows.size()));
+            while(clipper.Step()){
+                for(int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++){
+                    size_t entry = list.rows[row];
+                    if(ImGui::Selectable(snapshot.name(entry)))
+                        clicked = entry;
+                    prefetchIfNext(dir_ctx, snapshot, entry);
+                    // Only an active item can start a drag, so the path is only built for that one.
+                    if(ImGui::IsItemActive())
+                        ImGui::DragDrop::BeginSource(snapshot.path(entry));
                 }
+            }
+
+            openEntry(dir_ctx, snapshot, clicked);
+        }
 
-                if(ImGui::Selectable(dir_entry.path().filename().string().c_str())){
-                    if (dir_entry.is_directory()){
-                        dir_ctx.explorer->swapDir(dir_entry.path().string());
+        /**
+         * List the directory with size, modification time and type columns. Clicking a column header sorts by it.
+         * Sizes and times are fetched in the background, so they fill in after the names.
+         */
+        void ListDirectoryDetails(DirectoryCtx dir_ctx, const char* filter_list){
+            dir_ctx.explorer->poll();
+            dir_ctx.explorer->requestMetadata();
+            if(dir_ctx.explorer->isLoading())
+                ImGui::TextDisabled("Loading... %zu entries", dir_ctx.explorer->loadedCount());
+
+            ListState uncached;
+            ListState& list = dir_ctx.list ? *dir_ctx.list : uncached;
+            const DirSnapshot& snapshot = dir_ctx.explorer->getSnapshot();
+            updateRows(list, snapshot, filter_list);
+            if(listSearchResults(dir_ctx, list))
+                return;
+            sortRows(list, snapshot);
+
+            static const std::pair<const char*, ListState::SortColumn> headers[] = {
+                {"Name", ListState::SortColumn_Name},
+                {"Size", ListState::SortColumn_Size},
+                {"Modified", ListState::SortColumn_Modified},
+                {"Type", ListState::SortColumn_Type}
+            };
+            ImGui::Columns(IM_ARRAYSIZE(headers), "Directory Details");
+            for(auto& [title, column] : headers){
+                char label[64];
+                const char* arrow = list.sort_column != column ? "" : list.sort_descending ? " v" : " ^";
+                snprintf(label, sizeof(label), "%s%s##sort", title, arrow);
+                if(ImGui::Selectable(label)){
+                    if(list.sort_column == column)
+                        list.sort_descending = !list.sort_descending;
+                    else
+                        list.sort_descending = false;
+                    list.sort_column = column;
+                }
+                ImGui::NextColumn();
+            }
+            ImGui::Separator();
+
+            size_t clicked = DirSnapshot::npos;
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(list.rows.size()));
+            while(clipper.Step()){
+                for(int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++){
+                    size_t entry = list.rows[row];
+                    if(ImGui::Selectable(snapshot.name(entry), false, ImGuiSelectableFlags_SpanAllColumns))
+                        clicked = entry;
+                    prefetchIfNext(dir_ctx, snapshot, entry);
+                    if(ImGui::IsItemActive())
+                        ImGui::DragDrop::BeginSource(snapshot.path(entry));
+                    ImGui::NextColumn();
+
+                    bool has_metadata = snapshot.metadataState(entry) == DirSnapshot::MetadataState_Ready;
+                    if(snapshot.isDirectory(entry)){
+                        ImGui::TextUnformatted("");
+                    } else if(has_metadata) {
+                        static const char* units[] = {"B", "KB", "MB", "GB", "TB"};
+                        double size = static_cast<double>(snapshot.fileSize(entry));
+                        int unit = 0;
+                        for(; size >= 1024.0 && unit < IM_ARRAYSIZE(units) - 1; unit++)
+                            size /= 1024.0;
+                        ImGui::Text(unit == 0 ? "%.0f %s" : "%.1f %s", size, units[unit]);
+                    } else {
+                        ImGui::TextDisabled("...");
                     }
-                    else if(dir_entry.is_regular_file()) {
-                            dir_ctx.explorer->selectChild(dir_entry.path().string());
+                    ImGui::NextColumn();
+
+                    if(has_metadata){
+                        char modified[32];
+                        time_t seconds = static_cast<time_t>(snapshot.modifiedTime(entry) / 1000000000);
+                        // localtime() shares its result between threads, and fails for times it cannot represent.
+                        tm local{};
+#ifdef _WIN32
+                        bool converted = localtime_s(&local, &seconds) == 0;
+#else
+                        bool converted = localtime_r(&seconds, &local) != nullptr;
+#endif
+                        if(converted && strftime(modified, sizeof(modified), "%Y-%m-%d %H:%M", &local) > 0)
+                            ImGui::TextUnformatted(modified);
+                        else
+                            ImGui::TextDisabled("?");
+                    } else {
+                        ImGui::TextDisabled("...");
                     }
+                    ImGui::NextColumn();
+
+                    if(snapshot.isDirectory(entry))
+                        ImGui::TextUnformatted("Directory");
+                    else
+                        ImGui::TextUnformatted(snapshot.extension(snapshot.extensionId(entry)).c_str());
+                    ImGui::NextColumn();
                 }
-                ImGui::DragDrop::BeginSource(std::move(dir_entry.path()));
             }
+            ImGui::Columns(1);
+
+            openEntry(dir_ctx, snapshot, clicked);
         }
 
-        inline bool hasSelectedChild(DirExplorer dir_explorer){
+        inline bool hasSelectedChild(DirExplorer& dir_explorer){
             return dir_explorer.getSelected().has_filename();
         }
 
@@ -148,6 +560,121 @@ namespace ImGui {
             return c_action;
         }
 
+        /**
+         * Show the directory as a grid, with thumbnails for images.
+         * Thumbnails of the visible cells load first, a few rows above and below are prefetched, and the rest is cancelled.
+         */
+        void ListDirectoryThumbnails(DirectoryCtx dir_ctx, const char* filter_list, float thumbnail_size){
+            dir_ctx.explorer->poll();
+            if(dir_ctx.explorer->isLoading())
+                ImGui::TextDisabled("Loading... %zu entries", dir_ctx.explorer->loadedCount());
+            if(!dir_ctx.list)
+                return; // The thumbnails have to be kept between frames.
+            ListState& list = *dir_ctx.list;
+            const DirSnapshot& snapshot = dir_ctx.explorer->getSnapshot();
+            updateRows(list, snapshot, filter_list);
+            if(listSearchResults(dir_ctx, list))
+                return;
+
+            int size = static_cast<int>(thumbnail_size);
+            if(!list.thumbnails || list.thumbnail_size != size){
+                list.thumbnails = std::make_unique<ThumbnailCache>(size);
+                list.thumbnail_size = size;
+            }
+            if(list.thumbnails_dir != snapshot.directory().string()){
+                list.thumbnails->clear();
+                list.thumbnails_dir = snapshot.directory().string();
+            }
+
+            // Which extensions get a thumbnail, decided once per extension.
+            std::vector<uint8_t> has_thumbnail(snapshot.extensionCount());
+            for(size_t id = 0; id < has_thumbnail.size(); id++)
+                has_thumbnail[id] = ImageProbe::hasImageExtension(snapshot.extension(static_cast<DirSnapshot::ExtensionId>(id)));
+
+            const ImGuiStyle& style = ImGui::GetStyle();
+            ImVec2 cell_size{thumbnail_size, thumbnail_size + ImGui::GetTextLineHeightWithSpacing()};
+            int columns = std::max(1, static_cast<int>((ImGui::GetContentRegionAvail().x + style.ItemSpacing.x) / (cell_size.x + style.ItemSpacing.x)));
+            int row_count = (static_cast<int>(list.rows.size()) + columns - 1) / columns;
+            constexpr int prefetch_rows = 3;
+
+            size_t clicked = DirSnapshot::npos;
+            ImDrawList* draw_list = ImGui::GetWindowDrawList();
+            int first_visible = 0;
+            int last_visible = 0;
+            ImGuiListClipper clipper;
+            clipper.Begin(row_count, cell_size.y + style.ItemSpacing.y);
+            while(clipper.Step()){
+                first_visible = clipper.DisplayStart;
+                last_visible = clipper.DisplayEnd;
+                for(int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++){
+                    for(int column = 0; column < columns; column++){
+                        size_t index = static_cast<size_t>(row) * columns + column;
+                        if(index >= list.rows.size())
+                            break;
+                        size_t entry = list.rows[index];
+                        if(column > 0)
+                            ImGui::SameLine();
+
+                        ImGui::PushID(static_cast<int>(entry));
+                        ImVec2 cell_min = ImGui::GetCursorScreenPos();
+                        ImVec2 cell_max{cell_min.x + cell_size.x, cell_min.y + cell_size.y};
+                        if(ImGui::InvisibleButton("##cell", cell_size))
+                            clicked = entry;
+                        prefetchIfNext(dir_ctx, snapshot, entry, true);
+                        if(ImGui::IsItemActive())
+                            ImGui::DragDrop::BeginSource(snapshot.path(entry));
+                        if(ImGui::IsItemHovered())
+                            draw_list->AddRectFilled(cell_min, cell_max, ImGui::GetColorU32(ImGuiCol_Header));
+                        ImGui::PopID();
+
+                        ImVec2 image_min = cell_min;
+                        ImVec2 image_max{cell_min.x + cell_size.x, cell_min.y + thumbnail_size};
+                        ThumbnailCache::Thumbnail thumbnail;
+                        if(!snapshot.isDirectory(entry) && has_thumbnail[snapshot.extensionId(entry)])
+                            thumbnail = list.thumbnails->get(snapshot.path(entry).string());
+                        if(thumbnail.handle){
+                            // Fit the thumbnail inside its square, centered.
+                            float scale = std::min(thumbnail_size / thumbnail.width, thumbnail_size / thumbnail.height);
+                            ImVec2 fitted{thumbnail.width * scale, thumbnail.height * scale};
+                            image_min.x += (thumbnail_size - fitted.x) * 0.5f;
+                            image_min.y += (thumbnail_size - fitted.y) * 0.5f;
+                            draw_list->AddImage(
+                                reinterpret_cast<ImTextureID>(thumbnail.handle),
+                                image_min, {image_min.x + fitted.x, image_min.y + fitted.y}
+                            );
+                        } else {
+                            draw_list->AddRect(image_min, image_max, ImGui::GetColorU32(ImGuiCol_Border));
+                            const char* kind = snapshot.isDirectory(entry) ? "Directory" : "";
+                            draw_list->AddText({image_min.x + style.FramePadding.x, image_min.y + style.FramePadding.y}, ImGui::GetColorU32(ImGuiCol_TextDisabled), kind);
+                        }
+
+                        draw_list->PushClipRect({cell_min.x, image_max.y}, cell_max, true);
+                        draw_list->AddText({cell_min.x, image_max.y}, ImGui::GetColorU32(ImGuiCol_Text), snapshot.name(entry));
+                        draw_list->PopClipRect();
+                    }
+                }
+            }
+
+            // Prefetch the rows just outside of the view, nearest first.
+            for(int distance = 1; distance <= prefetch_rows && first_visible < last_visible; distance++){
+                for(int row: {last_visible - 1 + distance, first_visible - distance}){
+                    if(row < 0 || row >= row_count)
+                        continue;
+                    for(int column = 0; column < columns; column++){
+                        size_t index = static_cast<size_t>(row) * columns + column;
+                        if(index >= list.rows.size())
+                            break;
+                        size_t entry = list.rows[index];
+                        if(!snapshot.isDirectory(entry) && has_thumbnail[snapshot.extensionId(entry)])
+                            list.thumbnails->prefetch(snapshot.path(entry).string());
+                    }
+                }
+            }
+            list.thumbnails->update();
+
+            openEntry(dir_ctx, snapshot, clicked);
+        }
+
         void End(){
             ImGui::EndChild();
         }
@@ -171,6 +698,7 @@ namespace ImGui {
                 ImGui::DirectoryExplorer::ShowPathBar(dir_ctx, width_path_bar);
                 ImGui::SameLine();
                 ImGui::Text("%s", filter_list);
+                ImGui::DirectoryExplorer::ShowSearchBar(dir_ctx);
                 if(ImGui::DirectoryExplorer::SelectedChildShow(dir_ctx, selected_file_name) == ChildAction_OpenFile){
                     open = true;
                     show = false;
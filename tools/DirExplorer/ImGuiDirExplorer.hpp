@@ -11,15 +11,22 @@ enum ChildAction {
 
 namespace ImGui {
     namespace DirectoryExplorer {
+        struct ListState;
+
         struct DirectoryCtx {
             std::shared_ptr<DirExplorer> explorer;
+            // What ListDirectory derives from the explorer's snapshot, kept between frames.
+            std::shared_ptr<ListState> list;
         };
 
         DirectoryCtx NewDirExplorer(const std::string& context_name, const std::string& start_path);
         bool Begin(DirectoryCtx dir_ctx);
         void ShowHistoryButtons(DirectoryCtx dir_ctx);
         void ListDirectory(DirectoryCtx dir_ctx, const char * filter_list = "");
+        void ListDirectoryDetails(DirectoryCtx dir_ctx, const char * filter_list = "");
+        void ListDirectoryThumbnails(DirectoryCtx dir_ctx, const char * filter_list = "", float thumbnail_size = 96.0f);
         void ShowPathBar(DirectoryCtx dir_ctx, float width = -1.0f);
+        void ShowSearchBar(DirectoryCtx dir_ctx, float width = -1.0f);
         ChildAction SelectedChildShow(DirectoryCtx dir_ctx, std::string& fill_in);
         void End();
         bool OpenFileDialog(DirectoryCtx dir_ctx, std::string& selected_file_name, bool& show, const char* filter_list = "", const ImVec2& init_size = {300.0f,200.0f});
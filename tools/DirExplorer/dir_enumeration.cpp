@@ -0,0 +1,217 @@
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "dir_enumeration.hpp"
+#include "../Profiler/Profiler.hpp"
+#include "../TP/TP.hpp"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    /**
+     * Entries read in one go. Names are stored back to back, each one null terminated.
+     */
+    struct Chunk {
+        std::string names;
+        std::vector<uint8_t> types;
+
+        void add(std::string_view name, uint8_t type){
+            names.append(name);
+            names.push_back('\0');
+            types.push_back(type);
+        }
+    };
+}
+
+struct DirEnumeration::State {
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> running{true};
+    std::atomic<size_t> entries_read{0};
+
+    // Guards on_chunk as well, since it can be replaced while the directory is read.
+    std::mutex mutex;
+    std::deque<Chunk> chunks;
+    std::function<void()> on_chunk;
+
+    // Names removed before their chunk was taken. Only used by the thread taking the entries.
+    std::unordered_set<std::string> removed;
+
+    std::function<void()> chunkCallback(){
+        std::lock_guard<std::mutex> lock{mutex};
+        return on_chunk;
+    }
+
+    void publish(Chunk&& chunk){
+        if(chunk.types.empty())
+            return;
+        entries_read += chunk.types.size();
+        std::function<void()> callback;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            chunks.push_back(std::move(chunk));
+            callback = on_chunk;
+        }
+        chunk = Chunk{};
+        if(callback)
+            callback();
+    }
+
+#ifdef __linux__
+    struct linux_dirent64 {
+        ino64_t d_ino;
+        off64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+
+    static uint8_t typeAt(int dir_fd, const char* name, unsigned char d_type){
+        switch(d_type){
+            case DT_DIR:
+                return DirEntryType_Directory;
+            case DT_REG:
+                return DirEntryType_RegularFile;
+            case DT_LNK:
+            case DT_UNKNOWN:
+                break;
+            default:
+                return DirEntryType_Other;
+        }
+        // Links are listed by what they point at, and some file systems do not fill in d_type at all.
+        uint8_t type = d_type == DT_LNK ? DirEntryType_Symlink : DirEntryType_Other;
+        struct stat st;
+        if(fstatat(dir_fd, name, &st, 0) == 0){
+            if(S_ISDIR(st.st_mode))
+                type |= DirEntryType_Directory;
+            else if(S_ISREG(st.st_mode))
+                type |= DirEntryType_RegularFile;
+        }
+        if(d_type == DT_UNKNOWN && fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(st.st_mode))
+            type |= DirEntryType_Symlink;
+        return type;
+    }
+
+    /**
+     * Read the directory with getdents64 so that every system call returns a whole batch of entries.
+     */
+    void read(const std::filesystem::path& dir){
+        PROFILE_ZONE("Read directory");
+        int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(dir_fd < 0)
+            return;
+
+        alignas(linux_dirent64) char buffer[32 * 1024];
+        while(!cancelled){
+            long length = syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer));
+            if(length <= 0)
+                break;
+            Chunk chunk;
+            for(long offset = 0; offset < length; ){
+                auto* entry = reinterpret_cast<linux_dirent64*>(buffer + offset);
+                offset += entry->d_reclen;
+                const char* name = entry->d_name;
+                if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                    continue;
+                chunk.add(name, typeAt(dir_fd, name, entry->d_type));
+            }
+            publish(std::move(chunk));
+        }
+        close(dir_fd);
+    }
+#else
+    void read(const std::filesystem::path& dir){
+        PROFILE_ZONE("Read directory");
+        constexpr size_t chunk_size = 1024;
+        Chunk chunk;
+        std::error_code ec;
+        auto it = std::filesystem::directory_iterator(dir, ec);
+        for(; !ec && !cancelled && it != std::filesystem::directory_iterator(); it.increment(ec)){
+            chunk.add(it->path().filename().string(), DirSnapshot::entryType(*it));
+            if(chunk.types.size() == chunk_size)
+                publish(std::move(chunk));
+        }
+        publish(std::move(chunk));
+    }
+#endif
+};
+
+DirEnumeration DirEnumeration::start(const std::filesystem::path& dir, std::function<void()> on_chunk, TP::Priority priority){
+    DirEnumeration enumeration;
+    enumeration.state = std::make_shared<State>();
+    enumeration.state->on_chunk = std::move(on_chunk);
+
+    auto job = [state = enumeration.state, dir](){
+        if(!state->cancelled)
+            state->read(dir);
+        state->running = false;
+        if(auto on_chunk = state->chunkCallback())
+            on_chunk();
+    };
+    if(TP::thread_count() == 0)
+        job();
+    else
+        TP::add_job(std::move(job), priority);
+    return enumeration;
+}
+
+void DirEnumeration::setChunkCallback(std::function<void()> on_chunk){
+    if(!state)
+        return;
+    std::lock_guard<std::mutex> lock{state->mutex};
+    state->on_chunk = std::move(on_chunk);
+}
+
+void DirEnumeration::forget(std::string_view name){
+    if(!state || !state->running)
+        return;
+    state->removed.emplace(name);
+}
+
+void DirEnumeration::cancel(){
+    if(!state)
+        return;
+    state->cancelled = true;
+    std::lock_guard<std::mutex> lock{state->mutex};
+    state->chunks.clear();
+}
+
+bool DirEnumeration::takeEntries(DirSnapshot& snapshot){
+    if(!state)
+        return false;
+    std::deque<Chunk> chunks;
+    {
+        std::lock_guard<std::mutex> lock{state->mutex};
+        chunks.swap(state->chunks);
+    }
+    bool appended = false;
+    for(auto& chunk: chunks){
+        const char* name = chunk.names.data();
+        for(uint8_t type: chunk.types){
+            std::string_view name_view{name};
+            // The watcher may already have added an entry that was created while reading, or seen it removed.
+            if(snapshot.find(name_view) == DirSnapshot::npos && state->removed.count(std::string{name_view}) == 0){
+                snapshot.append(name_view, type);
+                appended = true;
+            }
+            name += name_view.size() + 1;
+        }
+    }
+    return appended;
+}
+
+bool DirEnumeration::isRunning() const {
+    return state && state->running;
+}
+
+size_t DirEnumeration::entriesRead() const {
+    return state ? state->entries_read.load() : 0;
+}
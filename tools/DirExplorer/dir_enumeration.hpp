@@ -0,0 +1,54 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include "dir_snapshot.hpp"
+#include "../TP/TP.hpp"
+
+/**
+ * Reads a directory on the thread pool and hands its entries over in chunks as they are read,
+ * so a huge (or slow) directory can be shown before it has been read to the end.
+ */
+class DirEnumeration {
+    struct State;
+    std::shared_ptr<State> state;
+public:
+    DirEnumeration() = default;
+
+    /**
+     * Start reading a directory. on_chunk is called from a worker every time entries are ready to take.
+     * If the thread pool has not been prepared, the directory is read before this returns.
+     * Reading ahead of time, before the directory is visited, is done at a low priority.
+     */
+    static DirEnumeration start(
+        const std::filesystem::path& dir,
+        std::function<void()> on_chunk = nullptr,
+        TP::Priority priority = TP::Priority_Normal
+    );
+
+    /**
+     * Replace on_chunk, e.g. when a directory read ahead of time is visited while it is still being read.
+     */
+    void setChunkCallback(std::function<void()> on_chunk);
+
+    /**
+     * Stop reading. Entries that were not taken yet are dropped.
+     */
+    void cancel();
+
+    /**
+     * Skip a name the watcher saw removed, in case it was read before it was removed and is still waiting to be taken.
+     * Only needed while reading.
+     */
+    void forget(std::string_view name);
+
+    /**
+     * Append the entries read since the last call to the snapshot, skipping names it already has.
+     * Returns true if anything was appended.
+     */
+    bool takeEntries(DirSnapshot& snapshot);
+
+    bool isRunning() const;
+    size_t entriesRead() const;
+};
@@ -24,6 +24,8 @@ SOFTWARE.
 
  */
 #include "dir_explorer.hpp"
+#include "../ImageLoad/ImageLoad.hpp"
+#include "../TP/TP.hpp"
 
 bool DirExplorer::isChild(const std::filesystem::path& test_it){
     if(test_it.parent_path() != this->curr_dir_path){
@@ -37,6 +39,39 @@ void DirExplorer::changeDir(std::filesystem::path new_dir){
     // For some reason we need to use the c_str representation of the path when swapping so that the directory iteration does not throw an error.
     this->curr_dir_path.swap(std::filesystem::path(new_dir.c_str()).make_preferred());
     this->selected_child = std::filesystem::path();
+    if(!this->adoptPrefetched())
+        this->refresh();
+}
+
+/**
+ * Use the read ahead listing of the current directory, if there is one that is still up to date.
+ */
+bool DirExplorer::adoptPrefetched(){
+    auto it = this->prefetched.find(this->curr_dir_path);
+    if(it == this->prefetched.end())
+        return false;
+    auto& prefetch = it->second;
+
+    // Watch first, so that a change is either seen by the watcher or has already changed the modification time.
+    this->watcher.watch(this->curr_dir_path);
+    std::error_code ec;
+    if(std::filesystem::last_write_time(this->curr_dir_path, ec) != prefetch.modified_time || ec){
+        prefetch.enumeration.cancel();
+        this->prefetched.erase(it);
+        return false;
+    }
+
+    this->enumeration.cancel();
+    this->metadata.cancel();
+    this->metadata_requested_generation = 0;
+    // Redraw for the rest like for a fresh read. Set before taking, so no chunk falls between the two.
+    prefetch.enumeration.setChunkCallback(this->on_change);
+    prefetch.enumeration.takeEntries(prefetch.snapshot);
+    this->snapshot.take(std::move(prefetch.snapshot));
+    // If it is still being read, the rest is taken by poll() as usual.
+    this->enumeration = prefetch.enumeration;
+    this->prefetched.erase(it);
+    return true;
 }
 
 /**
@@ -110,3 +145,161 @@ bool DirExplorer::selectChild(const std::string& child){
     this->selected_child = child;
     return true;
 }
+
+/**
+ * Read the current directory again.
+ * The snapshot is emptied and then filled in the background; entries show up as poll() takes them.
+ */
+void DirExplorer::refresh(){
+    this->enumeration.cancel();
+    this->metadata.cancel();
+    this->snapshot.clear(this->curr_dir_path);
+    // Watch before reading so that nothing that changes while reading is missed.
+    this->watcher.watch(this->curr_dir_path);
+    this->enumeration = DirEnumeration::start(this->curr_dir_path, this->on_change);
+}
+
+/**
+ * Show a snapshot built elsewhere instead of reading the directory, e.g. a synthetic one for a benchmark.
+ * The watcher keeps watching, so a change to the directory still reads it again.
+ */
+void DirExplorer::showSnapshot(DirSnapshot&& other){
+    this->enumeration.cancel();
+    this->metadata.cancel();
+    this->metadata_requested_generation = 0;
+    this->snapshot.take(std::move(other));
+}
+
+/**
+ * Apply the changes the watcher has seen to the snapshot.
+ * Returns true if the snapshot changed.
+ */
+bool DirExplorer::poll(){
+    bool changed = this->enumeration.takeEntries(this->snapshot);
+    changed |= this->metadata.takeResults(this->snapshot);
+
+    bool prefetch_grew = false;
+    for(auto& [dir, prefetch] : this->prefetched){
+        bool finished = !prefetch.enumeration.isRunning();
+        prefetch_grew |= prefetch.enumeration.takeEntries(prefetch.snapshot);
+        if(!finished || !prefetch.probe_images || prefetch.probed)
+            continue;
+        // Warm the probe cache, so the image headers are ready when the directory is shown.
+        prefetch.probed = true;
+        std::vector<std::string> images;
+        for(size_t i = 0; i < prefetch.snapshot.size(); i++){
+            if(prefetch.snapshot.isRegularFile(i) && ImageProbe::hasImageExtension(prefetch.snapshot.extension(prefetch.snapshot.extensionId(i))))
+                images.push_back(prefetch.snapshot.path(i).string());
+        }
+        if(!images.empty()){
+            TP::add_job([images = std::move(images)](){
+                ImageInfo info;
+                for(auto& image : images)
+                    ImageProbe::probe(image, info);
+            }, TP::Priority_Low);
+        }
+    }
+    if(prefetch_grew)
+        this->trimPrefetched();
+
+    std::vector<DirWatcher::Change> changes;
+    if(this->watcher.takeChanges(changes)){
+        this->refresh();
+        return true;
+    }
+    for(auto& change : changes){
+        size_t entry = this->snapshot.find(change.name);
+        switch(change.kind){
+            case DirWatcher::ChangeKind_Created:
+            case DirWatcher::ChangeKind_Modified:
+                if(entry == DirSnapshot::npos){
+                    this->snapshot.append(change.name, change.type);
+                    break;
+                }
+                if(this->snapshot.type(entry) != change.type)
+                    this->snapshot.setType(entry, change.type);
+                // Fetch the size and modification time again the next time they are asked for.
+                this->snapshot.setMetadataState(entry, DirSnapshot::MetadataState_Missing);
+                this->metadata_requested_generation = 0;
+                break;
+            case DirWatcher::ChangeKind_Removed:
+                if(entry != DirSnapshot::npos)
+                    this->snapshot.remove(entry);
+                else
+                    this->enumeration.forget(change.name);
+                break;
+        }
+    }
+    return changed || !changes.empty();
+}
+
+/**
+ * on_change is called from another thread when the current directory changes or more of it has been read,
+ * so that a view can be redrawn.
+ */
+void DirExplorer::setChangeCallback(std::function<void()> on_change){
+    this->on_change = on_change;
+    this->watcher.setCallback(std::move(on_change));
+}
+
+/**
+ * Fetch the size and modification time of the entries that do not have them yet.
+ * Cheap to call every frame; only entries that are missing metadata are requested.
+ */
+void DirExplorer::requestMetadata(){
+    if(this->metadata_requested_generation == this->snapshot.getGeneration())
+        return; // Nothing was added or modified since the last request.
+    this->metadata_requested_generation = this->snapshot.getGeneration();
+    this->metadata.request(this->snapshot, this->on_change);
+}
+
+/**
+ * Read a directory ahead of time, e.g. while its row is hovered, so that visiting it shows it at once.
+ * The read runs at a low priority on the thread pool, and probe_images also reads the headers of its images.
+ * Read ahead directories are kept under a memory limit, dropping the ones asked for longest ago.
+ */
+void DirExplorer::prefetch(const std::string& dir, bool probe_images){
+    std::filesystem::path path{std::filesystem::path(dir).make_preferred()};
+    if(path == this->curr_dir_path)
+        return;
+    auto it = this->prefetched.find(path);
+    if(it != this->prefetched.end()){
+        it->second.last_used = ++this->prefetch_clock;
+        it->second.probe_images |= probe_images;
+        return;
+    }
+
+    std::error_code ec;
+    auto modified_time = std::filesystem::last_write_time(path, ec);
+    if(ec || !std::filesystem::is_directory(path, ec))
+        return;
+    auto& prefetch = this->prefetched[path];
+    prefetch.snapshot.clear(path);
+    prefetch.modified_time = modified_time;
+    prefetch.probe_images = probe_images;
+    prefetch.last_used = ++this->prefetch_clock;
+    prefetch.enumeration = DirEnumeration::start(path, nullptr, TP::Priority_Low);
+    this->trimPrefetched();
+}
+
+void DirExplorer::setPrefetchMemoryLimit(size_t bytes){
+    this->prefetch_memory_limit = bytes;
+    this->trimPrefetched();
+}
+
+void DirExplorer::trimPrefetched(){
+    size_t used = 0;
+    for(auto& [dir, prefetch] : this->prefetched)
+        used += prefetch.snapshot.memoryUsage();
+    // The most recent one is always kept; it is the one about to be visited.
+    while(used > this->prefetch_memory_limit && this->prefetched.size() > 1){
+        auto oldest = this->prefetched.begin();
+        for(auto it = this->prefetched.begin(); it != this->prefetched.end(); it++){
+            if(it->second.last_used < oldest->second.last_used)
+                oldest = it;
+        }
+        used -= oldest->second.snapshot.memoryUsage();
+        oldest->second.enumeration.cancel();
+        this->prefetched.erase(oldest);
+    }
+}
@@ -1,7 +1,12 @@
 #pragma once
 #include <filesystem>
 #include <deque>
+#include <map>
 #include <string>
+#include "dir_enumeration.hpp"
+#include "dir_metadata.hpp"
+#include "dir_snapshot.hpp"
+#include "dir_watcher.hpp"
 
 class DirExplorer {
     std::string name;
@@ -11,14 +16,49 @@ class DirExplorer {
     // The history of navigating backwards from the forward history.
     std::deque<std::filesystem::path> history_backward;
     std::filesystem::path selected_child;
+    // The entries of the current directory, read once per directory change.
+    DirSnapshot snapshot;
+    // Fills the snapshot in the background after a directory change.
+    DirEnumeration enumeration;
+    // Fills in the metadata columns of the snapshot when a view asks for them.
+    DirMetadataFetch metadata;
+    // The snapshot generation metadata was last requested for.
+    uint64_t metadata_requested_generation = 0;
+    // Keeps the snapshot up to date without reading the directory again.
+    DirWatcher watcher;
+    std::function<void()> on_change;
+
+    // A directory read ahead of time, because it is likely to be visited next.
+    struct Prefetch {
+        DirSnapshot snapshot;
+        DirEnumeration enumeration;
+        // The directory's modification time from before it was read. If it differs on arrival, the read is stale.
+        std::filesystem::file_time_type modified_time;
+        bool probe_images = false;
+        bool probed = false;
+        uint64_t last_used = 0;
+    };
+    std::map<std::filesystem::path, Prefetch> prefetched;
+    uint64_t prefetch_clock = 0;
+    size_t prefetch_memory_limit = 16 * 1024 * 1024;
 
     bool isChild(const std::filesystem::path& test_it);
     void changeDir(std::filesystem::path new_dir);
+    bool adoptPrefetched();
+    void trimPrefetched();
 public:
     inline DirExplorer(const std::string& explorer_name = "", const std::string& start_directory = ""):
     name(explorer_name),
     curr_dir_path(start_directory)
-    {}
+    {
+        this->refresh();
+    }
+    inline ~DirExplorer() {
+        this->enumeration.cancel();
+        this->metadata.cancel();
+        for(auto& [dir, prefetch] : this->prefetched)
+            prefetch.enumeration.cancel();
+    }
 
     void returnForward();
     void goBackward();
@@ -26,6 +66,13 @@ public:
     bool getParentDir(std::string& parent_buf);
     bool visitParent();
     bool selectChild(const std::string& child);
+    void refresh();
+    void showSnapshot(DirSnapshot&& other);
+    bool poll();
+    void requestMetadata();
+    void prefetch(const std::string& dir, bool probe_images = false);
+    void setPrefetchMemoryLimit(size_t bytes);
+    void setChangeCallback(std::function<void()> on_change);
 
     inline bool hasBackwardHistory(){
         return this->history_backward.size() > 0;
@@ -36,12 +83,27 @@ public:
     inline std::string getCurrentDir() {
         return this->curr_dir_path.string();
     }
+    /**
+     * True while the current directory is still being read.
+     */
+    inline bool isLoading() const {
+        return this->enumeration.isRunning();
+    }
+    inline size_t loadedCount() const {
+        return this->enumeration.entriesRead();
+    }
     inline std::filesystem::directory_iterator begin() {
         return std::filesystem::directory_iterator(this->curr_dir_path);
     }
     inline const std::filesystem::directory_iterator end() {
         return std::filesystem::directory_iterator();
     }
+    /**
+     * The cached entries of the current directory.
+     */
+    inline const DirSnapshot& getSnapshot() const {
+        return this->snapshot;
+    }
     inline std::filesystem::path getSelected(){
         return this->selected_child;
     }
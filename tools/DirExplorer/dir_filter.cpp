@@ -0,0 +1,181 @@
+#include <cctype>
+#include "dir_filter.hpp"
+
+namespace {
+    inline char lower(char c){
+        return static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+
+    std::string toLower(std::string_view text){
+        std::string lowered{text};
+        for(auto& c: lowered)
+            c = lower(c);
+        return lowered;
+    }
+
+    std::string_view trim(std::string_view token){
+        while(!token.empty() && isspace(static_cast<unsigned char>(token.front())))
+            token.remove_prefix(1);
+        while(!token.empty() && isspace(static_cast<unsigned char>(token.back())))
+            token.remove_suffix(1);
+        return token;
+    }
+
+    /**
+     * Where the token at the start of the list ends. A regular expression can hold commas,
+     * so its token ends at the first comma after its closing slash.
+     */
+    size_t tokenEnd(std::string_view list){
+        size_t open = 0;
+        while(open < list.size() && isspace(static_cast<unsigned char>(list[open])))
+            open++;
+        size_t search_from = open;
+        if(open < list.size() && list[open] == '/'){
+            for(size_t i = open + 1; i < list.size(); i++){
+                if(list[i] == '\\'){
+                    i++;
+                } else if(list[i] == '/'){
+                    search_from = i + 1;
+                    break;
+                }
+            }
+        }
+        return list.find(',', search_from);
+    }
+}
+
+DirFilter::DirFilter(const std::string& filter_list)
+    : source{filter_list}
+{
+    std::string_view rest{source};
+    while(!rest.empty()){
+        auto comma = tokenEnd(rest);
+        auto token = trim(rest.substr(0, comma));
+        rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+        if(token.empty())
+            continue;
+
+        if(token.size() > 2 && token.front() == '/' && token.back() == '/'){
+            try {
+                patterns.emplace_back(
+                    std::string{token.substr(1, token.size() - 2)},
+                    std::regex::ECMAScript | std::regex::icase | std::regex::optimize
+                );
+            } catch(const std::regex_error&) {
+                // An invalid pattern matches nothing, but still keeps the filter from being empty (matching everything).
+                has_invalid_pattern = true;
+            }
+        } else if(token.find_first_of("*?[") != std::string_view::npos) {
+            globs.push_back(toLower(token));
+        } else {
+            extensions.insert(toLower(token));
+        }
+    }
+}
+
+/**
+ * Supports '*', '?' and character classes such as [abc], [a-z] and [!0-9].
+ * The pattern is already lower case.
+ */
+bool DirFilter::globMatch(std::string_view pattern, std::string_view name){
+    size_t p = 0, n = 0;
+    size_t star = std::string_view::npos, star_n = 0;
+    while(n < name.size()){
+        char c = lower(name[n]);
+        if(p < pattern.size()){
+            char pc = pattern[p];
+            if(pc == '*'){
+                star = p++;
+                star_n = n;
+                continue;
+            }
+            if(pc == '?'){
+                p++;
+                n++;
+                continue;
+            }
+            if(pc == '['){
+                size_t close = pattern.find(']', p + 2);
+                if(close != std::string_view::npos){
+                    size_t i = p + 1;
+                    bool negate = pattern[i] == '!' || pattern[i] == '^';
+                    if(negate)
+                        i++;
+                    bool in_class = false;
+                    for(; i < close; i++){
+                        if(i + 2 < close && pattern[i + 1] == '-'){
+                            in_class |= pattern[i] <= c && c <= pattern[i + 2];
+                            i += 2;
+                        } else {
+                            in_class |= pattern[i] == c;
+                        }
+                    }
+                    if(in_class != negate){
+                        p = close + 1;
+                        n++;
+                        continue;
+                    }
+                }
+            } else if(pc == c) {
+                p++;
+                n++;
+                continue;
+            }
+        }
+        // Mismatch: let the last '*' swallow one more character.
+        if(star == std::string_view::npos)
+            return false;
+        p = star + 1;
+        n = ++star_n;
+    }
+    while(p < pattern.size() && pattern[p] == '*')
+        p++;
+    return p == pattern.size();
+}
+
+bool DirFilter::matchesName(std::string_view name) const {
+    for(auto& glob: globs){
+        if(globMatch(glob, name))
+            return true;
+    }
+    for(auto& pattern: patterns){
+        if(std::regex_search(name.begin(), name.end(), pattern))
+            return true;
+    }
+    return false;
+}
+
+void DirFilter::match(const DirSnapshot& snapshot, std::vector<uint64_t>& bitmap) const {
+    size_t count = snapshot.size();
+    bitmap.assign((count + 63) / 64, 0);
+    if(empty()){
+        for(size_t i = 0; i < count; i++)
+            bitmap[i / 64] |= uint64_t(1) << (i % 64);
+        return;
+    }
+
+    // Decide once per extension instead of once per entry.
+    std::vector<uint8_t> extension_passes(snapshot.extensionCount());
+    for(size_t id = 0; id < extension_passes.size(); id++){
+        auto& extension = snapshot.extension(static_cast<DirSnapshot::ExtensionId>(id));
+        extension_passes[id] = !extension.empty() && extensions.count(toLower(extension)) > 0;
+    }
+
+    bool test_names = !globs.empty() || !patterns.empty();
+    for(size_t i = 0; i < count; i++){
+        bool passes = snapshot.isDirectory(i)
+            || extension_passes[snapshot.extensionId(i)]
+            || (test_names && matchesName(snapshot.nameView(i)));
+        if(passes)
+            bitmap[i / 64] |= uint64_t(1) << (i % 64);
+    }
+}
+
+bool DirFilter::passes(std::string_view name, bool is_directory) const {
+    if(is_directory || empty())
+        return true;
+    auto dot = name.rfind('.');
+    if(dot != std::string_view::npos && dot != 0 && extensions.count(toLower(name.substr(dot))) > 0)
+        return true;
+    return matchesName(name);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include "dir_snapshot.hpp"
+
+/**
+ * A filter list compiled once so that it can be matched against a whole snapshot at a time.
+ * Tokens are separated by commas:
+ *  - ".png" matches the extension, ignoring case.
+ *  - A token with wildcards ("*.tar.gz", "IMG_????.*", "[a-c]*") matches the whole name, ignoring case.
+ *  - A token between slashes ("/^frame_[0-9]+\.png$/") is a regular expression searched for in the name, ignoring case.
+ *    It may hold commas ("/^[a-z]{2,4}_/"); a slash in it has to be escaped ("\/"). An invalid expression matches nothing.
+ * An empty filter list matches everything. Directories always match, so they can still be visited.
+ */
+class DirFilter {
+    std::string source;
+    std::unordered_set<std::string> extensions;
+    std::vector<std::string> globs;
+    std::vector<std::regex> patterns;
+    bool has_invalid_pattern = false;
+
+    static bool globMatch(std::string_view pattern, std::string_view name);
+    bool matchesName(std::string_view name) const;
+public:
+    DirFilter(const std::string& filter_list = "");
+
+    inline const std::string& getSource() const
+    { return source; }
+
+    inline bool empty() const
+    { return extensions.empty() && globs.empty() && patterns.empty() && !has_invalid_pattern; }
+
+    /**
+     * Set bit i of the bitmap for every entry i of the snapshot that passes the filter.
+     */
+    void match(const DirSnapshot& snapshot, std::vector<uint64_t>& bitmap) const;
+
+    /**
+     * Test a single name, for entries that are not in a snapshot.
+     */
+    bool passes(std::string_view name, bool is_directory) const;
+};
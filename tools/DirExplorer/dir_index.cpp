@@ -0,0 +1,521 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sys/stat.h>
+#include "dir_index.hpp"
+#include "dir_snapshot.hpp"
+#include "../TP/TP.hpp"
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr char index_magic[8] = {'D', 'I', 'R', 'I', 'N', 'D', 'E', 'X'};
+    constexpr uint32_t index_version = 1;
+
+    /**
+     * The file starts with this header, followed by the nodes, the names and the root path.
+     */
+    struct IndexHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t node_count;
+        uint64_t names_size;
+        uint64_t root_size;
+    };
+
+    /**
+     * An entry of a directory being indexed.
+     */
+    struct Entry {
+        std::string name;
+        uint8_t type = DirEntryType_Other;
+        uint64_t size = 0;
+        int64_t modified_time = 0;
+        // The same entry in the previous index, or npos.
+        uint32_t previous = DirIndex::npos;
+    };
+
+    struct Stat {
+        uint8_t type = DirEntryType_Other;
+        uint64_t size = 0;
+        int64_t modified_time = 0;
+    };
+
+#ifdef __linux__
+    /**
+     * Stat an entry relative to its open directory. Links are not followed, so the walk cannot loop.
+     */
+    bool statAt(int dir_fd, const char* name, Stat& result){
+        struct statx stx;
+        if(statx(dir_fd, name, AT_STATX_DONT_SYNC | AT_SYMLINK_NOFOLLOW, STATX_TYPE | STATX_SIZE | STATX_MTIME, &stx) != 0)
+            return false;
+        if(S_ISDIR(stx.stx_mode))
+            result.type = DirEntryType_Directory;
+        else if(S_ISREG(stx.stx_mode))
+            result.type = DirEntryType_RegularFile;
+        else if(S_ISLNK(stx.stx_mode))
+            result.type = DirEntryType_Symlink;
+        else
+            result.type = DirEntryType_Other;
+        result.size = S_ISREG(stx.stx_mode) ? stx.stx_size : 0;
+        result.modified_time = static_cast<int64_t>(stx.stx_mtime.tv_sec) * 1000000000 + stx.stx_mtime.tv_nsec;
+        return true;
+    }
+
+    struct linux_dirent64 {
+        ino64_t d_ino;
+        off64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+
+    /**
+     * Read and stat every entry of a directory, a getdents64 batch at a time.
+     */
+    void readDirectory(const std::filesystem::path& dir, std::vector<Entry>& entries){
+        int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(dir_fd < 0)
+            return;
+        alignas(linux_dirent64) char buffer[32 * 1024];
+        while(true){
+            long length = syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer));
+            if(length <= 0)
+                break;
+            for(long offset = 0; offset < length; ){
+                auto* dirent = reinterpret_cast<linux_dirent64*>(buffer + offset);
+                offset += dirent->d_reclen;
+                const char* name = dirent->d_name;
+                if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                    continue;
+                Stat st;
+                if(!statAt(dir_fd, name, st))
+                    continue;
+                entries.push_back(Entry{name, st.type, st.size, st.modified_time});
+            }
+        }
+        close(dir_fd);
+    }
+
+    /**
+     * Stat only the subdirectories of an unchanged directory, whose own contents may still have changed.
+     */
+    void restatDirectories(const std::filesystem::path& dir, std::vector<Entry>& entries){
+        int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(dir_fd < 0)
+            return;
+        for(auto& entry: entries){
+            Stat st;
+            if(entry.type == DirEntryType_Directory && statAt(dir_fd, entry.name.c_str(), st))
+                entry.modified_time = st.modified_time;
+        }
+        close(dir_fd);
+    }
+#else
+    bool statPath(const std::filesystem::path& path, Stat& result){
+        std::error_code ec;
+        auto status = std::filesystem::symlink_status(path, ec);
+        if(ec)
+            return false;
+        if(std::filesystem::is_directory(status))
+            result.type = DirEntryType_Directory;
+        else if(std::filesystem::is_regular_file(status))
+            result.type = DirEntryType_RegularFile;
+        else if(std::filesystem::is_symlink(status))
+            result.type = DirEntryType_Symlink;
+        struct stat st;
+        if(stat(path.string().c_str(), &st) == 0){
+            result.size = result.type == DirEntryType_RegularFile ? st.st_size : 0;
+            result.modified_time = static_cast<int64_t>(st.st_mtime) * 1000000000;
+        }
+        return true;
+    }
+
+    void readDirectory(const std::filesystem::path& dir, std::vector<Entry>& entries){
+        std::error_code ec;
+        auto it = std::filesystem::directory_iterator(dir, ec);
+        for(; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)){
+            Stat st;
+            if(statPath(it->path(), st))
+                entries.push_back(Entry{it->path().filename().string(), st.type, st.size, st.modified_time});
+        }
+    }
+
+    void restatDirectories(const std::filesystem::path& dir, std::vector<Entry>& entries){
+        for(auto& entry: entries){
+            Stat st;
+            if(entry.type == DirEntryType_Directory && statPath(dir / entry.name, st))
+                entry.modified_time = st.modified_time;
+        }
+    }
+#endif
+
+    bool statRoot(const std::filesystem::path& root, Stat& result){
+#ifdef __linux__
+        return statAt(AT_FDCWD, root.c_str(), result);
+#else
+        return statPath(root, result);
+#endif
+    }
+}
+
+DirIndex::~DirIndex(){
+#ifdef __linux__
+    if(mapping)
+        munmap(mapping, mapping_size);
+#endif
+}
+
+std::filesystem::path DirIndex::path(uint32_t i) const {
+    std::vector<uint32_t> chain;
+    for(; i != 0 && i != npos; i = nodes[i].parent)
+        chain.push_back(i);
+    std::filesystem::path result = root;
+    for(auto it = chain.rbegin(); it != chain.rend(); it++)
+        result /= name(*it);
+    return result;
+}
+
+uint32_t DirIndex::find(const std::filesystem::path& relative) const {
+    if(node_count == 0)
+        return npos;
+    uint32_t current = 0;
+    for(auto& component: relative){
+        std::string part = component.string();
+        if(part.empty() || part == ".")
+            continue;
+        const Node& parent = nodes[current];
+        auto first = parent.first_child;
+        auto last = first + parent.child_count;
+        // Children are sorted by name.
+        while(first < last){
+            auto middle = first + (last - first) / 2;
+            if(name(middle) < part)
+                first = middle + 1;
+            else
+                last = middle;
+        }
+        if(first == parent.first_child + parent.child_count || name(first) != part)
+            return npos;
+        current = first;
+    }
+    return current;
+}
+
+uint64_t DirIndex::folderSize(const std::filesystem::path& relative) const {
+    uint32_t i = find(relative);
+    return i == npos ? 0 : nodes[i].size;
+}
+
+void DirIndex::findByName(std::string_view needle, std::vector<uint32_t>& results, size_t max_results) const {
+    auto equal = [](char a, char b){
+        return tolower(static_cast<unsigned char>(a)) == tolower(static_cast<unsigned char>(b));
+    };
+    for(uint32_t i = 1; i < node_count && results.size() < max_results; i++){
+        std::string_view candidate = name(i);
+        if(std::search(candidate.begin(), candidate.end(), needle.begin(), needle.end(), equal) != candidate.end())
+            results.push_back(i);
+    }
+}
+
+bool DirIndex::save(const std::filesystem::path& file) const {
+    std::string root_string = root.string();
+    IndexHeader header{};
+    std::memcpy(header.magic, index_magic, sizeof(index_magic));
+    header.version = index_version;
+    header.node_count = static_cast<uint32_t>(node_count);
+    header.names_size = names_size;
+    header.root_size = root_string.size();
+
+    // Write next to the file and rename it over, so a crash never leaves half an index behind.
+    auto temporary = file;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if(!out)
+            return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(nodes), node_count * sizeof(Node));
+        out.write(names, names_size);
+        out.write(root_string.data(), root_string.size());
+        if(!out)
+            return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(temporary, file, ec);
+    return !ec;
+}
+
+std::shared_ptr<DirIndex> DirIndex::load(const std::filesystem::path& file){
+    auto index = std::make_shared<DirIndex>();
+    const char* data = nullptr;
+    size_t data_size = 0;
+#ifdef __linux__
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return nullptr;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(IndexHeader))){
+        close(fd);
+        return nullptr;
+    }
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+        return nullptr;
+    index->mapping = mapping;
+    index->mapping_size = st.st_size;
+    data = static_cast<const char*>(mapping);
+    data_size = st.st_size;
+#else
+    // Without mmap, read the whole file and point into the copy instead.
+    std::ifstream in(file, std::ios::binary);
+    index->file_contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if(index->file_contents.size() < sizeof(IndexHeader))
+        return nullptr;
+    data = index->file_contents.data();
+    data_size = index->file_contents.size();
+#endif
+
+    IndexHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    size_t nodes_size = static_cast<size_t>(header.node_count) * sizeof(Node);
+    if(std::memcmp(header.magic, index_magic, sizeof(index_magic)) != 0
+        || header.version != index_version
+        || header.node_count == 0
+        || header.names_size == 0
+        || sizeof(IndexHeader) + nodes_size + header.names_size + header.root_size != data_size
+        || data[sizeof(IndexHeader) + nodes_size + header.names_size - 1] != '\0'
+    )
+        return nullptr;
+
+    // A stale or damaged file must not send find(), path() or name() out of bounds, so every link is checked once here.
+    const Node* nodes = reinterpret_cast<const Node*>(data + sizeof(IndexHeader));
+    for(uint32_t i = 0; i < header.node_count; i++){
+        const Node& node = nodes[i];
+        bool parent_valid = i == 0 ? node.parent == npos : node.parent < i;
+        bool children_valid = node.child_count == 0
+            || (node.first_child > i && static_cast<uint64_t>(node.first_child) + node.child_count <= header.node_count);
+        if(!parent_valid || !children_valid || node.name_offset >= header.names_size)
+            return nullptr;
+    }
+
+    index->node_count = header.node_count;
+    index->nodes = reinterpret_cast<const Node*>(data + sizeof(IndexHeader));
+    index->names = data + sizeof(IndexHeader) + nodes_size;
+    index->names_size = header.names_size;
+    index->root = std::string(index->names + header.names_size, header.root_size);
+    return index;
+}
+
+struct DirIndexer::State : std::enable_shared_from_this<DirIndexer::State> {
+    /**
+     * A directory waiting to be read.
+     */
+    struct Work {
+        uint32_t node;
+        // The same directory in the previous index, or npos.
+        uint32_t previous;
+        int64_t modified_time;
+        std::filesystem::path dir;
+    };
+
+    std::filesystem::path root;
+    std::filesystem::path index_file;
+    std::shared_ptr<const DirIndex> previous;
+    std::function<void()> on_done;
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> running{true};
+    std::atomic<size_t> entries_indexed{0};
+    std::atomic<size_t> pending{0};
+
+    std::mutex mutex;
+    std::vector<DirIndex::Node> nodes;
+    std::string names;
+    std::shared_ptr<const DirIndex> result;
+
+    // Without worker threads the walk runs on the calling thread from this queue.
+    bool inline_walk = false;
+    std::deque<Work> inline_work;
+
+    void spawn(Work&& work){
+        pending++;
+        if(inline_walk)
+            inline_work.push_back(std::move(work));
+        else
+            TP::add_job([self = shared_from_this(), work = std::move(work)](){ self->process(work); });
+    }
+
+    /**
+     * List one directory, append its entries to the trie and queue its subdirectories.
+     */
+    void process(const Work& work){
+        if(!cancelled){
+            std::vector<Entry> entries;
+            bool unchanged = false;
+            if(work.previous != DirIndex::npos){
+                const auto& old = previous->node(work.previous);
+                unchanged = old.modified_time == work.modified_time;
+                if(unchanged){
+                    // Same names as last time; only the subdirectories need a fresh look.
+                    entries.reserve(old.child_count);
+                    for(uint32_t child = old.first_child; child < old.first_child + old.child_count; child++){
+                        const auto& node = previous->node(child);
+                        entries.push_back(Entry{std::string(previous->name(child)), node.type, node.size, node.modified_time, child});
+                    }
+                    restatDirectories(work.dir, entries);
+                }
+            }
+            if(!unchanged){
+                readDirectory(work.dir, entries);
+                std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b){ return a.name < b.name; });
+                if(work.previous != DirIndex::npos){
+                    // Both listings are sorted, so matching them up is a merge.
+                    const auto& old = previous->node(work.previous);
+                    uint32_t child = old.first_child;
+                    uint32_t last = old.first_child + old.child_count;
+                    for(auto& entry: entries){
+                        while(child < last && previous->name(child) < entry.name)
+                            child++;
+                        if(child < last && previous->name(child) == entry.name)
+                            entry.previous = child;
+                    }
+                }
+            }
+            entries_indexed += entries.size();
+
+            uint32_t first_child;
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                first_child = static_cast<uint32_t>(nodes.size());
+                for(auto& entry: entries){
+                    bool is_directory = entry.type == DirEntryType_Directory;
+                    nodes.push_back(DirIndex::Node{
+                        is_directory ? 0 : entry.size,
+                        entry.modified_time,
+                        work.node,
+                        static_cast<uint32_t>(names.size()),
+                        0,
+                        0,
+                        entry.type,
+                        {}
+                    });
+                    names.append(entry.name);
+                    names.push_back('\0');
+                }
+                nodes[work.node].first_child = first_child;
+                nodes[work.node].child_count = static_cast<uint32_t>(entries.size());
+            }
+
+            // Links are not followed, so every directory is visited once.
+            for(uint32_t i = 0; i < entries.size(); i++){
+                auto& entry = entries[i];
+                if(entry.type != DirEntryType_Directory)
+                    continue;
+                uint32_t previous_dir = entry.previous != DirIndex::npos && previous->isDirectory(entry.previous) ? entry.previous : DirIndex::npos;
+                spawn(Work{first_child + i, previous_dir, entry.modified_time, work.dir / entry.name});
+            }
+        }
+        if(--pending == 0)
+            finish();
+    }
+
+    /**
+     * Add up the folder sizes and publish the index. Runs once, after the last directory.
+     */
+    void finish(){
+        if(!cancelled){
+            // Children come after their parents, so walking backwards totals every subtree in one pass.
+            for(size_t i = nodes.size() - 1; i > 0; i--)
+                nodes[nodes[i].parent].size += nodes[i].size;
+
+            auto index = std::make_shared<DirIndex>();
+            index->root = root;
+            index->owned_nodes = std::move(nodes);
+            index->owned_names = std::move(names);
+            index->nodes = index->owned_nodes.data();
+            index->node_count = index->owned_nodes.size();
+            index->names = index->owned_names.data();
+            index->names_size = index->owned_names.size();
+            if(!index_file.empty())
+                index->save(index_file);
+
+            std::lock_guard<std::mutex> lock{mutex};
+            result = std::move(index);
+        }
+        previous.reset();
+        running = false;
+        if(on_done)
+            on_done();
+    }
+
+    void run(){
+        if(!index_file.empty()){
+            auto loaded = DirIndex::load(index_file);
+            if(loaded && loaded->getRoot() == root)
+                previous = std::move(loaded);
+        }
+        Stat st;
+        if(cancelled || !statRoot(root, st) || st.type != DirEntryType_Directory){
+            running = false;
+            if(on_done)
+                on_done();
+            return;
+        }
+        nodes.push_back(DirIndex::Node{0, st.modified_time, DirIndex::npos, 0, 0, 0, DirEntryType_Directory, {}});
+        names.push_back('\0');
+        spawn(Work{0, previous ? 0 : DirIndex::npos, st.modified_time, root});
+
+        while(!inline_work.empty()){
+            Work work = std::move(inline_work.front());
+            inline_work.pop_front();
+            process(work);
+        }
+    }
+};
+
+DirIndexer DirIndexer::start(const std::filesystem::path& root, const std::filesystem::path& index_file, std::function<void()> on_done){
+    DirIndexer indexer;
+    indexer.state = std::make_shared<State>();
+    indexer.state->root = root;
+    indexer.state->index_file = index_file;
+    indexer.state->on_done = std::move(on_done);
+
+    if(TP::thread_count() == 0){
+        indexer.state->inline_walk = true;
+        indexer.state->run();
+    } else {
+        TP::add_job([state = indexer.state](){ state->run(); });
+    }
+    return indexer;
+}
+
+void DirIndexer::cancel(){
+    if(state)
+        state->cancelled = true;
+}
+
+std::shared_ptr<const DirIndex> DirIndexer::takeIndex(){
+    if(!state)
+        return nullptr;
+    std::lock_guard<std::mutex> lock{state->mutex};
+    return std::move(state->result);
+}
+
+bool DirIndexer::isRunning() const {
+    return state && state->running;
+}
+
+size_t DirIndexer::entriesIndexed() const {
+    return state ? state->entries_indexed.load() : 0;
+}
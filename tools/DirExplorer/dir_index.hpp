@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Every entry below a root directory, stored as a trie of path components.
+ * Node 0 is the root. The children of a node are stored next to each other, sorted by name,
+ * and always after their parent, so a reverse pass visits children before parents.
+ * An index is immutable once built, which lets it be read from any thread and mapped straight from a file.
+ */
+class DirIndex {
+public:
+    struct Node {
+        // Files: the size of the file. Directories: the size of every file below them.
+        uint64_t size;
+        // Nanoseconds since the epoch.
+        int64_t modified_time;
+        uint32_t parent;
+        uint32_t name_offset;
+        uint32_t first_child;
+        uint32_t child_count;
+        // A DirEntryType.
+        uint8_t type;
+        uint8_t padding[7];
+    };
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    DirIndex() = default;
+    DirIndex(const DirIndex&) = delete;
+    DirIndex& operator=(const DirIndex&) = delete;
+    ~DirIndex();
+
+    /**
+     * Write the index to a file, replacing it atomically.
+     */
+    bool save(const std::filesystem::path& file) const;
+
+    /**
+     * Map an index written by save(). Returns nullptr if the file is missing or not a valid index.
+     */
+    static std::shared_ptr<DirIndex> load(const std::filesystem::path& file);
+
+    inline const std::filesystem::path& getRoot() const
+    { return root; }
+    inline size_t size() const
+    { return node_count; }
+    inline const Node& node(uint32_t i) const
+    { return nodes[i]; }
+    inline std::string_view name(uint32_t i) const
+    { return names + nodes[i].name_offset; }
+    inline bool isDirectory(uint32_t i) const
+    { return nodes[i].type & 1; }
+
+    /**
+     * The full path of a node.
+     */
+    std::filesystem::path path(uint32_t i) const;
+
+    /**
+     * The node of a path relative to the root, or npos.
+     */
+    uint32_t find(const std::filesystem::path& relative) const;
+
+    /**
+     * The total size of the files below a directory relative to the root, or of a single file.
+     */
+    uint64_t folderSize(const std::filesystem::path& relative) const;
+
+    /**
+     * Collect the nodes whose name contains the needle, ignoring case, up to max_results of them.
+     */
+    void findByName(std::string_view needle, std::vector<uint32_t>& results, size_t max_results = SIZE_MAX) const;
+
+private:
+    friend class DirIndexer;
+
+    std::filesystem::path root;
+    const Node* nodes = nullptr;
+    size_t node_count = 0;
+    const char* names = nullptr;
+    size_t names_size = 0;
+
+    // Set when the index was built in memory.
+    std::vector<Node> owned_nodes;
+    std::string owned_names;
+    // Set when the index was mapped from a file, or read into memory where mmap is not available.
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    std::string file_contents;
+};
+
+/**
+ * Builds a DirIndex by walking the subtree on the thread pool, one job per directory.
+ * When given the index of a previous run, directories whose modification time did not change
+ * reuse its listing instead of being read and stat'ed again; only their subdirectories are checked.
+ */
+class DirIndexer {
+    struct State;
+    std::shared_ptr<State> state;
+public:
+    /**
+     * Start indexing root. If index_file is given, the previous index is loaded from it and the new one is saved to it.
+     * on_done is called from a worker once the index is ready to take.
+     */
+    static DirIndexer start(
+        const std::filesystem::path& root,
+        const std::filesystem::path& index_file = {},
+        std::function<void()> on_done = nullptr
+    );
+
+    /**
+     * Stop the walk; no index is produced.
+     */
+    void cancel();
+
+    /**
+     * The finished index, or nullptr while the walk is still running.
+     */
+    std::shared_ptr<const DirIndex> takeIndex();
+
+    bool isRunning() const;
+    size_t entriesIndexed() const;
+};
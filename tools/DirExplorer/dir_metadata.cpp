@@ -0,0 +1,144 @@
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "dir_metadata.hpp"
+#include "../TP/TP.hpp"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Large enough that a job is worth queueing, small enough that results trickle in while the rest is read.
+    constexpr size_t batch_size = 512;
+
+    /**
+     * The metadata of a batch of entries, column by column. Names are stored back to back, each one null terminated.
+     */
+    struct Batch {
+        std::string names;
+        std::vector<uint64_t> file_sizes;
+        std::vector<int64_t> modified_times;
+        std::vector<uint8_t> found;
+        size_t count = 0;
+    };
+
+#ifdef __linux__
+    /**
+     * Stat every entry relative to one open directory, so the path is not resolved again for each entry.
+     */
+    void fetch(const std::filesystem::path& dir, Batch& batch){
+        int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        const char* name = batch.names.data();
+        for(size_t i = 0; i < batch.count; i++, name += strlen(name) + 1){
+            if(dir_fd < 0)
+                continue;
+            struct statx stx;
+            if(statx(dir_fd, name, AT_STATX_DONT_SYNC, STATX_SIZE | STATX_MTIME, &stx) != 0)
+                continue;
+            batch.file_sizes[i] = stx.stx_size;
+            batch.modified_times[i] = static_cast<int64_t>(stx.stx_mtime.tv_sec) * 1000000000 + stx.stx_mtime.tv_nsec;
+            batch.found[i] = true;
+        }
+        if(dir_fd >= 0)
+            close(dir_fd);
+    }
+#else
+    void fetch(const std::filesystem::path& dir, Batch& batch){
+        const char* name = batch.names.data();
+        for(size_t i = 0; i < batch.count; i++, name += strlen(name) + 1){
+            struct stat st;
+            if(stat((dir / name).string().c_str(), &st) != 0)
+                continue;
+            batch.file_sizes[i] = st.st_size;
+            batch.modified_times[i] = static_cast<int64_t>(st.st_mtime) * 1000000000;
+            batch.found[i] = true;
+        }
+    }
+#endif
+}
+
+struct DirMetadataFetch::State {
+    std::atomic<bool> cancelled{false};
+    std::mutex mutex;
+    std::deque<Batch> results;
+};
+
+void DirMetadataFetch::request(DirSnapshot& snapshot, std::function<void()> on_batch){
+    if(!state)
+        state = std::make_shared<State>();
+
+    auto submit = [&](Batch&& batch){
+        batch.file_sizes.resize(batch.count);
+        batch.modified_times.resize(batch.count);
+        batch.found.resize(batch.count);
+        auto job = [state = state, dir = snapshot.directory(), batch = std::move(batch), on_batch]() mutable {
+            if(state->cancelled)
+                return;
+            fetch(dir, batch);
+            {
+                std::lock_guard<std::mutex> lock{state->mutex};
+                state->results.push_back(std::move(batch));
+            }
+            if(on_batch)
+                on_batch();
+        };
+        if(TP::thread_count() == 0)
+            job();
+        else
+            TP::add_job(std::move(job));
+    };
+
+    Batch batch;
+    for(size_t i = 0; i < snapshot.size(); i++){
+        if(snapshot.metadataState(i) != DirSnapshot::MetadataState_Missing)
+            continue;
+        snapshot.setMetadataState(i, DirSnapshot::MetadataState_Requested);
+        batch.names.append(snapshot.nameView(i));
+        batch.names.push_back('\0');
+        if(++batch.count == batch_size){
+            submit(std::move(batch));
+            batch = Batch{};
+        }
+    }
+    if(batch.count > 0)
+        submit(std::move(batch));
+}
+
+bool DirMetadataFetch::takeResults(DirSnapshot& snapshot){
+    if(!state)
+        return false;
+    std::deque<Batch> results;
+    {
+        std::lock_guard<std::mutex> lock{state->mutex};
+        results.swap(state->results);
+    }
+    bool stored = false;
+    for(auto& batch: results){
+        const char* name = batch.names.data();
+        for(size_t i = 0; i < batch.count; i++, name += strlen(name) + 1){
+            // Entries can be removed or moved around by the watcher while their metadata is fetched.
+            size_t entry = snapshot.find(name);
+            if(entry == DirSnapshot::npos || snapshot.metadataState(entry) != DirSnapshot::MetadataState_Requested)
+                continue;
+            if(batch.found[i])
+                snapshot.setMetadata(entry, batch.file_sizes[i], batch.modified_times[i]);
+            else
+                snapshot.setMetadata(entry, 0, 0);
+            stored = true;
+        }
+    }
+    return stored;
+}
+
+void DirMetadataFetch::cancel(){
+    if(!state)
+        return;
+    state->cancelled = true;
+    state.reset();
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include "dir_snapshot.hpp"
+
+/**
+ * Reads the size and modification time of the entries of a snapshot on the thread pool,
+ * a batch of entries per job, and stores the results in the snapshot's metadata columns.
+ */
+class DirMetadataFetch {
+    struct State;
+    std::shared_ptr<State> state;
+public:
+    /**
+     * Start fetching the metadata of every entry that is missing it.
+     * on_batch is called from a worker every time a batch of results is ready to take.
+     */
+    void request(DirSnapshot& snapshot, std::function<void()> on_batch = nullptr);
+
+    /**
+     * Store the results fetched since the last call. Returns true if anything was stored.
+     */
+    bool takeResults(DirSnapshot& snapshot);
+
+    /**
+     * Drop the fetches in flight, e.g. because the snapshot is of another directory now.
+     */
+    void cancel();
+};
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include "dir_search.hpp"
+#include "../TP/TP.hpp"
+
+namespace {
+    inline char lower(char c){
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    /**
+     * One bit per letter and digit; other bytes share the remaining bits.
+     */
+    inline uint64_t charBit(char c){
+        unsigned char u = static_cast<unsigned char>(lower(c));
+        if(u >= 'a' && u <= 'z')
+            return uint64_t(1) << (u - 'a');
+        if(u >= '0' && u <= '9')
+            return uint64_t(1) << (26 + u - '0');
+        return uint64_t(1) << (36 + u % 28);
+    }
+
+    uint64_t charMask(std::string_view text){
+        uint64_t mask = 0;
+        for(char c: text)
+            mask |= charBit(c);
+        return mask;
+    }
+
+    /**
+     * Score a candidate against a lower case query, or return INT_MIN if it does not match.
+     * Matches at the start of a word and runs of consecutive characters count more; gaps and long names count less.
+     */
+    int32_t score(std::string_view name, std::string_view query){
+        int32_t total = 0;
+        int32_t run = 0;
+        size_t matched = 0;
+        size_t last = std::string_view::npos;
+        for(size_t i = 0; i < name.size() && matched < query.size(); i++){
+            // Skip ahead to the next occurrence of the wanted character in either case.
+            char wanted = query[matched];
+            char wanted_upper = wanted >= 'a' && wanted <= 'z' ? static_cast<char>(wanted - 'a' + 'A') : wanted;
+            while(i < name.size() && name[i] != wanted && name[i] != wanted_upper)
+                i++;
+            if(i == name.size())
+                break;
+            int32_t bonus = 1;
+            if(i == 0){
+                bonus += 8;
+            } else {
+                char previous = name[i - 1];
+                bool word_start = previous == '/' || previous == '_' || previous == '-' || previous == '.' || previous == ' ';
+                bool camel_hump = previous >= 'a' && previous <= 'z' && name[i] >= 'A' && name[i] <= 'Z';
+                if(word_start || camel_hump)
+                    bonus += 6;
+            }
+            if(last != std::string_view::npos){
+                if(last + 1 == i)
+                    bonus += 4 * ++run;
+                else {
+                    run = 0;
+                    total -= static_cast<int32_t>(std::min<size_t>(i - last - 1, 8));
+                }
+            }
+            total += bonus;
+            last = i;
+            matched++;
+        }
+        if(matched < query.size())
+            return INT_MIN;
+        return total - static_cast<int32_t>(name.size() / 8);
+    }
+
+    // Below this many candidates per part, handing the work to the thread pool costs more than it saves.
+    constexpr size_t part_size = 32 * 1024;
+
+    /**
+     * Shared with the jobs, which may only get to run after forEachPart() has returned.
+     */
+    struct PartsState {
+        std::atomic<size_t> next_part{0};
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t remaining;
+    };
+
+    /**
+     * Run fn(part) for every part, and wait for all of them. This thread and the thread pool take parts
+     * until none are left, so a pool busy with long jobs cannot hold up the caller.
+     */
+    template<typename Fn>
+    void forEachPart(size_t parts, const Fn& fn){
+        auto state = std::make_shared<PartsState>();
+        state->remaining = parts;
+        // fn is only called for parts taken before every part is done, so it is never used after returning.
+        auto take_parts = [state, &fn, parts](){
+            size_t part;
+            while((part = state->next_part++) < parts){
+                fn(part);
+                std::lock_guard<std::mutex> lock{state->mutex};
+                if(--state->remaining == 0)
+                    state->done.notify_one();
+            }
+        };
+        for(size_t helper = 1; helper < parts; helper++)
+            TP::add_job(take_parts, TP::Priority_Frame);
+        take_parts();
+        std::unique_lock<std::mutex> lock{state->mutex};
+        state->done.wait(lock, [&](){ return state->remaining == 0; });
+    }
+}
+
+void DirSearch::setCandidates(size_t count, const std::function<std::string_view(size_t)>& name){
+    names.resize(count);
+    masks.resize(count);
+    for(size_t i = 0; i < count; i++){
+        names[i] = name(i);
+        masks[i] = charMask(names[i]);
+    }
+    searched = false;
+    matches.clear();
+    scores.clear();
+    ranked.clear();
+}
+
+void DirSearch::update(std::string_view new_query){
+    std::string lowered(new_query);
+    for(auto& c: lowered)
+        c = lower(c);
+    if(searched && lowered == query)
+        return;
+    // An empty query keeps no matches, so there is nothing to narrow from it.
+    bool narrowing = searched && !query.empty() && lowered.compare(0, query.size(), query) == 0;
+    query = std::move(lowered);
+    searched = true;
+
+    if(query.empty()){
+        matches.clear();
+        scores.clear();
+        ranked.clear();
+        return;
+    }
+
+    uint64_t query_mask = charMask(query);
+    std::vector<uint32_t> candidates;
+    if(narrowing){
+        candidates.swap(matches);
+    } else {
+        // A flat pass over the masks, which the compiler can vectorise.
+        candidates.reserve(names.size() / 4);
+        for(size_t i = 0; i < masks.size(); i++){
+            if((masks[i] & query_mask) == query_mask)
+                candidates.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    // Score in parts, each on its own thread when there are enough candidates, then join the parts in order.
+    size_t parts = std::min(TP::thread_count() + 1, candidates.size() / part_size + 1);
+    std::vector<std::vector<uint32_t>> part_matches(parts);
+    std::vector<std::vector<int32_t>> part_scores(parts);
+    forEachPart(parts, [&](size_t part){
+        size_t begin = candidates.size() * part / parts;
+        size_t end = candidates.size() * (part + 1) / parts;
+        for(size_t i = begin; i < end; i++){
+            uint32_t candidate = candidates[i];
+            if((masks[candidate] & query_mask) != query_mask)
+                continue;
+            int32_t candidate_score = score(names[candidate], query);
+            if(candidate_score == INT_MIN)
+                continue;
+            part_matches[part].push_back(candidate);
+            part_scores[part].push_back(candidate_score);
+        }
+    });
+    matches.clear();
+    scores.clear();
+    for(size_t part = 0; part < parts; part++){
+        matches.insert(matches.end(), part_matches[part].begin(), part_matches[part].end());
+        scores.insert(scores.end(), part_scores[part].begin(), part_scores[part].end());
+    }
+
+    // Only the best few are ever shown, so only they are sorted.
+    std::vector<uint32_t> order(matches.size());
+    for(uint32_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    auto better = [&](uint32_t a, uint32_t b){
+        if(scores[a] != scores[b])
+            return scores[a] > scores[b];
+        return matches[a] < matches[b];
+    };
+    size_t kept = std::min(max_results, order.size());
+    std::partial_sort(order.begin(), order.begin() + kept, order.end(), better);
+    ranked.resize(kept);
+    for(size_t i = 0; i < kept; i++)
+        ranked[i] = matches[order[i]];
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Fuzzy search over a list of names: the query's characters have to appear in order, not necessarily next to each other.
+ * Every candidate carries a mask of the characters in it, so most of them are rejected with a single AND
+ * before the scorer looks at them. Typing more characters only narrows the previous matches.
+ */
+class DirSearch {
+public:
+    // The best matches that are ranked and kept in results().
+    static constexpr size_t max_results = 1000;
+
+    /**
+     * Replace the candidates. The names have to stay valid until the next call; the search starts over.
+     */
+    void setCandidates(size_t count, const std::function<std::string_view(size_t)>& name);
+
+    /**
+     * Match the query, from the previous matches if the query only grew at the end.
+     */
+    void update(std::string_view query);
+
+    inline const std::string& getQuery() const
+    { return query; }
+    inline size_t candidateCount() const
+    { return names.size(); }
+    inline size_t matchCount() const
+    { return matches.size(); }
+
+    /**
+     * The candidates of the best matches, best first.
+     */
+    inline const std::vector<uint32_t>& results() const
+    { return ranked; }
+
+private:
+    std::vector<std::string_view> names;
+    std::vector<uint64_t> masks;
+
+    std::string query;
+    bool searched = false;
+    // Every candidate matching the query and its score.
+    std::vector<uint32_t> matches;
+    std::vector<int32_t> scores;
+    std::vector<uint32_t> ranked;
+};
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cstring>
+#include "dir_snapshot.hpp"
+
+namespace {
+    /**
+     * Same as std::filesystem::path::extension(), without building a path.
+     */
+    std::string_view extensionOf(std::string_view name){
+        auto dot = name.rfind('.');
+        if(dot == std::string_view::npos || dot == 0)
+            return {};
+        return name.substr(dot);
+    }
+}
+
+DirSnapshot::DirSnapshot()
+    : name_block_used{name_block_size}
+    , name_bytes_used{}
+    , name_bytes_removed{}
+    , metadata_generation{}
+    , generation{}
+{
+    extensions.emplace_back(); // no_extension
+}
+
+uint8_t DirSnapshot::entryType(const std::filesystem::directory_entry& entry){
+    std::error_code ec;
+    uint8_t type = DirEntryType_Other;
+    // is_directory() and is_regular_file() follow symlinks, so a link to a directory can still be visited.
+    if(entry.is_directory(ec))
+        type |= DirEntryType_Directory;
+    else if(entry.is_regular_file(ec))
+        type |= DirEntryType_RegularFile;
+    if(entry.is_symlink(ec))
+        type |= DirEntryType_Symlink;
+    return type;
+}
+
+std::string_view DirSnapshot::intern(std::string_view name){
+    size_t needed = name.size() + 1;
+    name_bytes_used += needed;
+    if(needed > name_block_size){
+        // Too big to share a block.
+        name_blocks.push_back(std::make_unique<char[]>(needed));
+        memcpy(name_blocks.back().get(), name.data(), name.size());
+        name_blocks.back()[name.size()] = '\0';
+        return {name_blocks.back().get(), name.size()};
+    }
+    if(name_block_used + needed > name_block_size){
+        name_blocks.push_back(std::make_unique<char[]>(name_block_size));
+        name_block_used = 0;
+    }
+    char* interned = name_blocks.back().get() + name_block_used;
+    memcpy(interned, name.data(), name.size());
+    interned[name.size()] = '\0';
+    name_block_used += needed;
+    return {interned, name.size()};
+}
+
+DirSnapshot::ExtensionId DirSnapshot::internExtension(std::string_view name){
+    auto ext = extensionOf(name);
+    if(ext.empty())
+        return no_extension;
+    std::string key{ext};
+    auto it = extension_lookup.find(key);
+    if(it != extension_lookup.end())
+        return it->second;
+    if(extensions.size() > UINT16_MAX)
+        return no_extension; // Out of ids; treat the rest as having no extension.
+    ExtensionId id = static_cast<ExtensionId>(extensions.size());
+    extensions.push_back(key);
+    extension_lookup.emplace(std::move(key), id);
+    return id;
+}
+
+void DirSnapshot::clear(const std::filesystem::path& dir){
+    dir_path = dir;
+    name_blocks.clear();
+    name_block_used = name_block_size;
+    name_bytes_used = 0;
+    name_bytes_removed = 0;
+    names.clear();
+    types.clear();
+    extension_ids.clear();
+    name_lookup.clear();
+    file_sizes.clear();
+    modified_times.clear();
+    metadata_states.clear();
+    metadata_generation++;
+    extensions.resize(1);
+    extension_lookup.clear();
+    generation++;
+}
+
+void DirSnapshot::take(DirSnapshot&& other){
+    uint64_t next_generation = std::max(generation, other.generation) + 1;
+    uint64_t next_metadata_generation = std::max(metadata_generation, other.metadata_generation) + 1;
+    *this = std::move(other);
+    generation = next_generation;
+    metadata_generation = next_metadata_generation;
+    other = DirSnapshot();
+}
+
+size_t DirSnapshot::memoryUsage() const {
+    // The columns, plus about one hash node per name.
+    size_t per_entry = sizeof(std::string_view) + sizeof(uint8_t) * 2 + sizeof(ExtensionId)
+        + sizeof(uint64_t) + sizeof(int64_t) + 4 * sizeof(void*);
+    return name_blocks.size() * name_block_size + names.size() * per_entry;
+}
+
+void DirSnapshot::scan(const std::filesystem::path& dir){
+    clear(dir);
+    std::error_code ec;
+    auto it = std::filesystem::directory_iterator(dir, ec);
+    for(; !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+        append(it->path().filename().string(), entryType(*it));
+}
+
+size_t DirSnapshot::append(std::string_view name, uint8_t type){
+    names.push_back(intern(name));
+    types.push_back(type);
+    extension_ids.push_back(internExtension(name));
+    file_sizes.push_back(0);
+    modified_times.push_back(0);
+    metadata_states.push_back(MetadataState_Missing);
+    name_lookup[names.back()] = names.size() - 1;
+    generation++;
+    return names.size() - 1;
+}
+
+size_t DirSnapshot::find(std::string_view name) const {
+    auto it = name_lookup.find(name);
+    if(it == name_lookup.end())
+        return npos;
+    return it->second;
+}
+
+void DirSnapshot::remove(size_t i){
+    name_lookup.erase(names[i]);
+    name_bytes_removed += names[i].size() + 1;
+
+    size_t last = names.size() - 1;
+    if(i != last){
+        names[i] = names[last];
+        types[i] = types[last];
+        extension_ids[i] = extension_ids[last];
+        file_sizes[i] = file_sizes[last];
+        modified_times[i] = modified_times[last];
+        metadata_states[i] = metadata_states[last];
+        name_lookup[names[i]] = i;
+    }
+    names.pop_back();
+    types.pop_back();
+    extension_ids.pop_back();
+    file_sizes.pop_back();
+    modified_times.pop_back();
+    metadata_states.pop_back();
+    generation++;
+
+    // Removed names stay in their blocks; once they are most of the blocks, intern the live names again.
+    if(name_bytes_removed > name_block_size && name_bytes_removed * 2 > name_bytes_used)
+        compactNames();
+}
+
+void DirSnapshot::setType(size_t i, uint8_t type){
+    types[i] = type;
+    generation++;
+}
+
+void DirSnapshot::setMetadata(size_t i, uint64_t file_size, int64_t modified_time){
+    file_sizes[i] = file_size;
+    modified_times[i] = modified_time;
+    metadata_states[i] = MetadataState_Ready;
+    metadata_generation++;
+}
+
+void DirSnapshot::setMetadataState(size_t i, MetadataState state){
+    metadata_states[i] = state;
+}
+
+void DirSnapshot::compactNames(){
+    auto old_blocks = std::move(name_blocks);
+    name_blocks.clear();
+    name_block_used = name_block_size;
+    name_bytes_used = 0;
+    name_bytes_removed = 0;
+    name_lookup.clear();
+    for(size_t i = 0; i < names.size(); i++){
+        names[i] = intern(names[i]);
+        name_lookup[names[i]] = i;
+    }
+}
+
+std::filesystem::path DirSnapshot::path(size_t i) const {
+    return dir_path / std::filesystem::path(names[i]);
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum DirEntryType : uint8_t {
+    DirEntryType_Other = 0,
+    DirEntryType_Directory = 1 << 0,
+    DirEntryType_RegularFile = 1 << 1,
+    DirEntryType_Symlink = 1 << 2
+};
+
+/**
+ * A flat table of the entries of a single directory.
+ * Names are interned into blocks that never move, the entry types are kept as bits and
+ * extensions are kept as ids into a small table, so walking the table every frame does not allocate.
+ */
+class DirSnapshot {
+public:
+    using ExtensionId = uint16_t;
+    static constexpr ExtensionId no_extension = 0;
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    enum MetadataState : uint8_t {
+        MetadataState_Missing,
+        MetadataState_Requested,
+        MetadataState_Ready
+    };
+private:
+    static constexpr size_t name_block_size = 64 * 1024;
+
+    std::filesystem::path dir_path;
+    std::vector<std::unique_ptr<char[]>> name_blocks;
+    size_t name_block_used;
+    size_t name_bytes_used;
+    size_t name_bytes_removed;
+
+    std::vector<std::string_view> names;
+    std::vector<uint8_t> types;
+    std::vector<ExtensionId> extension_ids;
+    std::unordered_map<std::string_view, size_t> name_lookup;
+
+    // Metadata columns; filled in later than the names (see DirMetadataFetch).
+    std::vector<uint64_t> file_sizes;
+    std::vector<int64_t> modified_times;
+    std::vector<uint8_t> metadata_states;
+    uint64_t metadata_generation;
+
+    std::vector<std::string> extensions;
+    std::unordered_map<std::string, ExtensionId> extension_lookup;
+
+    uint64_t generation;
+
+    std::string_view intern(std::string_view name);
+    ExtensionId internExtension(std::string_view name);
+    void compactNames();
+public:
+    DirSnapshot();
+
+    static uint8_t entryType(const std::filesystem::directory_entry& entry);
+
+    /**
+     * Empty the table and make it a table of another directory.
+     */
+    void clear(const std::filesystem::path& dir);
+
+    /**
+     * Read the directory into the table. An unreadable directory leaves the table empty.
+     */
+    void scan(const std::filesystem::path& dir);
+
+    /**
+     * Replace the table with another one, e.g. one read ahead of time, leaving the other empty.
+     * The generations still move forward, so anything derived from the old table is thrown away.
+     */
+    void take(DirSnapshot&& other);
+
+    /**
+     * Roughly how many bytes the table holds on to.
+     */
+    size_t memoryUsage() const;
+
+    size_t append(std::string_view name, uint8_t type);
+
+    /**
+     * Returns the index of the entry with the name, or npos.
+     */
+    size_t find(std::string_view name) const;
+
+    /**
+     * Remove an entry. The last entry takes its place, so indices past this call are not stable.
+     */
+    void remove(size_t i);
+
+    void setType(size_t i, uint8_t type);
+
+    void setMetadata(size_t i, uint64_t file_size, int64_t modified_time);
+    void setMetadataState(size_t i, MetadataState state);
+
+    inline MetadataState metadataState(size_t i) const
+    { return static_cast<MetadataState>(metadata_states[i]); }
+
+    inline uint64_t fileSize(size_t i) const
+    { return file_sizes[i]; }
+
+    /**
+     * Nanoseconds since the unix epoch.
+     */
+    inline int64_t modifiedTime(size_t i) const
+    { return modified_times[i]; }
+
+    /**
+     * Changes every time metadata is stored, separately from getGeneration().
+     */
+    inline uint64_t getMetadataGeneration() const
+    { return metadata_generation; }
+
+    inline size_t size() const
+    { return names.size(); }
+
+    /**
+     * The name of an entry. It is always null terminated.
+     */
+    inline const char* name(size_t i) const
+    { return names[i].data(); }
+
+    inline std::string_view nameView(size_t i) const
+    { return names[i]; }
+
+    inline uint8_t type(size_t i) const
+    { return types[i]; }
+
+    inline bool isDirectory(size_t i) const
+    { return types[i] & DirEntryType_Directory; }
+
+    inline bool isRegularFile(size_t i) const
+    { return types[i] & DirEntryType_RegularFile; }
+
+    inline ExtensionId extensionId(size_t i) const
+    { return extension_ids[i]; }
+
+    /**
+     * The extension for an id, including the dot (e.g. ".png").
+     */
+    inline const std::string& extension(ExtensionId id) const
+    { return extensions[id]; }
+
+    inline size_t extensionCount() const
+    { return extensions.size(); }
+
+    inline const std::filesystem::path& directory() const
+    { return dir_path; }
+
+    /**
+     * The full path of an entry. This allocates, so only call it when the path is needed.
+     */
+    std::filesystem::path path(size_t i) const;
+
+    /**
+     * Changes every time the table changes. Anything derived from the table can be kept until the generation changes.
+     */
+    inline uint64_t getGeneration() const
+    { return generation; }
+};
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include "dir_thumbnails.hpp"
+#include "../TP/TP.hpp"
+
+namespace {
+    enum LoadState {
+        LoadState_Loading,
+        LoadState_Ready,
+        LoadState_Failed
+    };
+
+    /**
+     * One thumbnail being loaded, shared with the workers doing it.
+     */
+    struct Load {
+        std::atomic<bool> cancelled{false};
+        std::atomic<int> state{LoadState_Loading};
+        // Written by the worker before the state becomes ready.
+        std::shared_ptr<Texture> texture;
+    };
+
+    // Decodes queued on the thread pool at once. Kept low so that new requests are never stuck behind old ones.
+    size_t maxInFlight(){
+        return std::max<size_t>(2, TP::thread_count());
+    }
+}
+
+struct ThumbnailCache::State {
+    struct Entry {
+        std::shared_ptr<Load> load;
+        uint64_t last_used = 0;
+    };
+
+    int thumbnail_size;
+    size_t capacity;
+    uint64_t frame = 1;
+    std::unordered_map<std::string, Entry> entries;
+    // What was asked for this frame, most wanted first.
+    std::vector<std::string> visible;
+    std::vector<std::string> nearby;
+    std::vector<std::shared_ptr<Load>> in_flight;
+
+    Entry& touch(const std::string& path){
+        auto& entry = entries[path];
+        entry.last_used = frame;
+        return entry;
+    }
+
+    void start(const std::string& path, Entry& entry){
+        auto load = std::make_shared<Load>();
+        entry.load = load;
+        in_flight.push_back(load);
+        TP::add_job([load, path, size = thumbnail_size](){
+            if(load->cancelled){
+                load->state = LoadState_Failed;
+                return;
+            }
+            ImagePixelData pixels(path, false, TargetSize{size, size});
+            if(load->cancelled || !pixels.isLoaded()){
+                load->state = LoadState_Failed;
+                return;
+            }
+            auto texture = std::make_shared<Texture>(std::move(pixels));
+            Texture::uploadAsync(texture, [load, texture](){
+                load->texture = texture;
+                load->state = LoadState_Ready;
+            });
+        });
+    }
+};
+
+ThumbnailCache::ThumbnailCache(int thumbnail_size, size_t capacity)
+    : state{std::make_shared<State>()}
+{
+    state->thumbnail_size = thumbnail_size;
+    state->capacity = capacity;
+}
+
+ThumbnailCache::~ThumbnailCache() {
+    clear();
+}
+
+ThumbnailCache::Thumbnail ThumbnailCache::get(const std::string& path){
+    auto& entry = state->touch(path);
+    if(!entry.load)
+        state->visible.push_back(path);
+    else if(entry.load->state == LoadState_Ready){
+        auto& texture = entry.load->texture;
+        return {texture->getHandle(), texture->getWidth(), texture->getHeight()};
+    }
+    return {};
+}
+
+void ThumbnailCache::prefetch(const std::string& path){
+    auto& entry = state->touch(path);
+    if(!entry.load)
+        state->nearby.push_back(path);
+}
+
+void ThumbnailCache::update(){
+    // Finished loads make room for new ones. A cancelled load still holds its place until its worker is done with it.
+    auto& in_flight = state->in_flight;
+    in_flight.erase(std::remove_if(in_flight.begin(), in_flight.end(), [](auto& load){
+        return load->state != LoadState_Loading;
+    }), in_flight.end());
+
+    for(auto it = state->entries.begin(); it != state->entries.end(); ){
+        auto& entry = it->second;
+        bool wanted = entry.last_used == state->frame;
+        if(!wanted && (!entry.load || entry.load->state == LoadState_Loading)){
+            // Scrolled away before it was loaded; it will be asked for again if it comes back.
+            if(entry.load)
+                entry.load->cancelled = true;
+            it = state->entries.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    for(auto* paths: {&state->visible, &state->nearby}){
+        for(auto& path: *paths){
+            if(in_flight.size() >= maxInFlight())
+                break;
+            auto it = state->entries.find(path);
+            if(it != state->entries.end() && !it->second.load)
+                state->start(path, it->second);
+        }
+        paths->clear();
+    }
+
+    // Evict the thumbnails that were used longest ago. Textures are deleted once the gpu is done with them.
+    if(state->entries.size() > state->capacity){
+        std::vector<std::pair<uint64_t, const std::string*>> by_age;
+        for(auto& [path, entry]: state->entries){
+            if(entry.last_used != state->frame)
+                by_age.emplace_back(entry.last_used, &path);
+        }
+        size_t excess = std::min(by_age.size(), state->entries.size() - state->capacity);
+        std::nth_element(by_age.begin(), by_age.begin() + excess, by_age.end());
+        std::vector<std::string> evicted;
+        for(size_t i = 0; i < excess; i++)
+            evicted.push_back(*by_age[i].second);
+        for(auto& path: evicted)
+            state->entries.erase(path);
+    }
+    state->frame++;
+}
+
+void ThumbnailCache::clear(){
+    for(auto& [path, entry]: state->entries){
+        if(entry.load)
+            entry.load->cancelled = true;
+    }
+    state->entries.clear();
+    state->visible.clear();
+    state->nearby.clear();
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "../ImageLoad/ImageLoad.hpp"
+
+/**
+ * Thumbnails for a grid of files, loaded in the order the grid needs them.
+ * Every frame the grid asks for the thumbnails of its visible cells and prefetches the ones around them.
+ * Visible cells are decoded first, then prefetched ones, with only a few decodes in flight at a time;
+ * anything not asked for again is cancelled, so scrolling past a folder does not leave a queue of stale work behind.
+ */
+class ThumbnailCache {
+    struct State;
+    std::shared_ptr<State> state;
+public:
+    struct Thumbnail {
+        ImageRID handle{};
+        int width{};
+        int height{};
+    };
+
+    /**
+     * Thumbnails fit inside thumbnail_size squared. At most capacity of them are kept on the gpu.
+     */
+    ThumbnailCache(int thumbnail_size = 128, size_t capacity = 512);
+    ~ThumbnailCache();
+
+    ThumbnailCache(const ThumbnailCache& copy) = delete;
+    ThumbnailCache& operator=(const ThumbnailCache& assign) = delete;
+
+    /**
+     * The thumbnail of a visible cell. Its handle is 0 until it has been loaded.
+     */
+    Thumbnail get(const std::string& path);
+
+    /**
+     * Load the thumbnail of a cell near the visible ones, once the visible ones are done.
+     */
+    void prefetch(const std::string& path);
+
+    /**
+     * Start the loads that are wanted most and cancel the ones no longer wanted. Called once per frame, after the requests.
+     */
+    void update();
+
+    /**
+     * Drop every thumbnail, e.g. when another directory is shown.
+     */
+    void clear();
+};
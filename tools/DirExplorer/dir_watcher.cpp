@@ -0,0 +1,239 @@
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "dir_watcher.hpp"
+#include "dir_snapshot.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <chrono>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    /**
+     * Changes keyed by name, so that a burst of events for one entry becomes a single change.
+     */
+    struct ChangeSet {
+        std::vector<DirWatcher::Change> changes;
+        std::unordered_map<std::string, size_t> lookup;
+        bool rescan = false;
+
+        void add(DirWatcher::ChangeKind kind, std::string name){
+            auto it = lookup.find(name);
+            if(it == lookup.end()){
+                lookup.emplace(name, changes.size());
+                changes.push_back({kind, DirEntryType_Other, std::move(name)});
+                return;
+            }
+            auto& change = changes[it->second];
+            // A created entry that is then modified is still just a created entry.
+            if(!(change.kind == DirWatcher::ChangeKind_Created && kind == DirWatcher::ChangeKind_Modified))
+                change.kind = kind;
+        }
+
+        void merge(ChangeSet&& other){
+            rescan |= other.rescan;
+            for(auto& change: other.changes){
+                auto it = lookup.find(change.name);
+                if(it == lookup.end()){
+                    lookup.emplace(change.name, changes.size());
+                    changes.push_back(std::move(change));
+                } else if(!(changes[it->second].kind == DirWatcher::ChangeKind_Created && change.kind == DirWatcher::ChangeKind_Modified)) {
+                    changes[it->second] = std::move(change);
+                }
+            }
+        }
+
+        void clear(){
+            changes.clear();
+            lookup.clear();
+            rescan = false;
+        }
+    };
+}
+
+struct DirWatcher::State {
+    std::mutex mutex;
+    std::filesystem::path dir;
+    int wd = -1;
+    ChangeSet pending;
+    std::function<void()> on_change;
+
+    int inotify_fd = -1;
+    int stop_fd = -1;
+    std::thread thread;
+
+#ifdef __linux__
+    // Wait this long after an event for more events before handing the changes over.
+    static constexpr int coalesce_ms = 20;
+    // But never hold changes back for longer than this while events keep arriving.
+    static constexpr int max_delay_ms = 100;
+
+    void publish(ChangeSet& batch, int batch_wd){
+        std::function<void()> notify;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            if(batch_wd != wd){
+                // The directory changed while the events were being collected.
+                batch.clear();
+                return;
+            }
+            for(auto& change: batch.changes){
+                if(change.kind != ChangeKind_Removed)
+                    change.type = DirSnapshot::entryType(std::filesystem::directory_entry(dir / change.name));
+            }
+            pending.merge(std::move(batch));
+            notify = on_change;
+        }
+        batch.clear();
+        if(notify)
+            notify();
+    }
+
+    void run(){
+        alignas(struct inotify_event) char buffer[64 * 1024];
+        ChangeSet batch;
+        int batch_wd = -1;
+        auto first_event = std::chrono::steady_clock::now();
+
+        while(true){
+            pollfd fds[2] = {
+                {inotify_fd, POLLIN, 0},
+                {stop_fd, POLLIN, 0}
+            };
+            bool collecting = !batch.changes.empty() || batch.rescan;
+            int ready = poll(fds, 2, collecting ? coalesce_ms : -1);
+            if(ready < 0){
+                if(errno == EINTR)
+                    continue;
+                break;
+            }
+            if(fds[1].revents)
+                break; // Stopped.
+            if(ready == 0){
+                // The burst is over.
+                publish(batch, batch_wd);
+                continue;
+            }
+
+            ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+            if(length <= 0)
+                continue;
+            int current_wd;
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                current_wd = wd;
+            }
+            if(!collecting){
+                first_event = std::chrono::steady_clock::now();
+                batch_wd = current_wd;
+            } else if(batch_wd != current_wd){
+                batch.clear();
+                batch_wd = current_wd;
+            }
+            for(char* it = buffer; it < buffer + length; ){
+                auto* event = reinterpret_cast<struct inotify_event*>(it);
+                it += sizeof(struct inotify_event) + event->len;
+
+                if(event->mask & IN_Q_OVERFLOW){
+                    batch.rescan = true;
+                    continue;
+                }
+                if(event->wd != current_wd)
+                    continue; // Left over from a directory that is no longer watched.
+                if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)){
+                    batch.rescan = true;
+                    continue;
+                }
+                if(event->len == 0)
+                    continue;
+
+                if(event->mask & (IN_CREATE | IN_MOVED_TO))
+                    batch.add(ChangeKind_Created, event->name);
+                else if(event->mask & (IN_DELETE | IN_MOVED_FROM))
+                    batch.add(ChangeKind_Removed, event->name);
+                else if(event->mask & (IN_CLOSE_WRITE | IN_ATTRIB))
+                    batch.add(ChangeKind_Modified, event->name);
+            }
+
+            auto waited = std::chrono::steady_clock::now() - first_event;
+            if(waited > std::chrono::milliseconds(max_delay_ms))
+                publish(batch, batch_wd);
+        }
+    }
+#endif
+};
+
+DirWatcher::DirWatcher()
+    : state{std::make_unique<State>()}
+{}
+
+DirWatcher::~DirWatcher() {
+#ifdef __linux__
+    if(state->thread.joinable()){
+        uint64_t stop = 1;
+        (void)!write(state->stop_fd, &stop, sizeof(stop));
+        state->thread.join();
+    }
+    if(state->inotify_fd >= 0)
+        close(state->inotify_fd);
+    if(state->stop_fd >= 0)
+        close(state->stop_fd);
+#endif
+}
+
+bool DirWatcher::watch(const std::filesystem::path& dir){
+#ifdef __linux__
+    if(state->inotify_fd < 0){
+        state->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        state->stop_fd = eventfd(0, EFD_CLOEXEC);
+        if(state->inotify_fd < 0 || state->stop_fd < 0)
+            return false;
+        state->thread = std::thread([state = state.get()](){
+            state->run();
+        });
+    }
+
+    std::lock_guard<std::mutex> lock{state->mutex};
+    if(state->wd >= 0)
+        inotify_rm_watch(state->inotify_fd, state->wd);
+    state->dir = dir;
+    state->pending.clear();
+    state->wd = inotify_add_watch(
+        state->inotify_fd,
+        dir.c_str(),
+        IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR
+    );
+    return state->wd >= 0;
+#else
+    (void)dir;
+    return false;
+#endif
+}
+
+void DirWatcher::stop(){
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock{state->mutex};
+    if(state->wd >= 0)
+        inotify_rm_watch(state->inotify_fd, state->wd);
+    state->wd = -1;
+    state->pending.clear();
+#endif
+}
+
+void DirWatcher::setCallback(std::function<void()> on_change){
+    std::lock_guard<std::mutex> lock{state->mutex};
+    state->on_change = std::move(on_change);
+}
+
+bool DirWatcher::takeChanges(std::vector<Change>& changes){
+    std::lock_guard<std::mutex> lock{state->mutex};
+    bool rescan = state->pending.rescan;
+    changes = std::move(state->pending.changes);
+    state->pending.clear();
+    return rescan;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Watches a directory for entries being created, removed, renamed or modified.
+ * Changes are collected on a background thread, bursts are coalesced, and then on_change is called
+ * so the owner knows to take them. Only Linux (inotify) is supported; elsewhere watch() returns false.
+ */
+class DirWatcher {
+public:
+    enum ChangeKind : uint8_t {
+        ChangeKind_Created,
+        ChangeKind_Removed,
+        ChangeKind_Modified
+    };
+
+    struct Change {
+        ChangeKind kind;
+        uint8_t type; // DirEntryType bits, for created and modified entries.
+        std::string name;
+    };
+private:
+    struct State;
+    std::unique_ptr<State> state;
+public:
+    DirWatcher();
+    ~DirWatcher();
+
+    DirWatcher(const DirWatcher& copy) = delete;
+    DirWatcher& operator=(const DirWatcher& assign) = delete;
+
+    /**
+     * Start watching a directory instead of the one being watched.
+     */
+    bool watch(const std::filesystem::path& dir);
+    void stop();
+
+    /**
+     * on_change is called from the watcher thread whenever there are changes to take.
+     */
+    void setCallback(std::function<void()> on_change);
+
+    /**
+     * Move the changes seen since the last call into changes.
+     * Returns true if events were lost (or the directory itself went away) and the directory has to be read again.
+     */
+    bool takeChanges(std::vector<Change>& changes);
+};
@@ -0,0 +1,271 @@
+#include <cstdio>
+#include <cstring>
+#include "DrawCapture.hpp"
+#include "../Profiler/Profiler.hpp"
+
+namespace DrawCapture {
+    namespace {
+        constexpr char file_magic[8] = {'I', 'M', 'D', 'R', 'A', 'W', 'C', 'P'};
+        constexpr uint32_t file_version = 1;
+
+        struct FileHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t vertex_size;
+            uint32_t index_size;
+            uint32_t reserved;
+        };
+
+        /**
+         * Each frame is a FrameHeader followed by its draw lists:
+         * a ListHeader, the vertices, the indices and the commands, back to back.
+         */
+        struct FrameHeader {
+            float display_pos[2];
+            float display_size[2];
+            float framebuffer_scale[2];
+            uint32_t list_count;
+            uint32_t reserved;
+        };
+
+        struct ListHeader {
+            uint32_t vertex_count;
+            uint32_t index_count;
+            uint32_t command_count;
+            uint32_t flags;
+        };
+
+        struct Command {
+            float clip_rect[4];
+            uint64_t texture_id;
+            uint32_t vertex_offset;
+            uint32_t index_offset;
+            uint32_t element_count;
+            uint32_t reserved;
+        };
+
+        static FILE* recording = nullptr;
+
+        /**
+         * Check that every command of a list only uses the list's own indices and vertices,
+         * so a damaged file cannot make the renderer read past the buffers.
+         */
+        bool commandsInRange(const char* list_data, const ListHeader& list){
+            const char* index_data = list_data + static_cast<size_t>(list.vertex_count) * sizeof(ImDrawVert);
+            const char* command_data = index_data + static_cast<size_t>(list.index_count) * sizeof(ImDrawIdx);
+            for(uint32_t c = 0; c < list.command_count; c++){
+                Command command;
+                memcpy(&command, command_data + c * sizeof(Command), sizeof(command));
+                if(command.element_count == 0)
+                    continue;
+                if(static_cast<uint64_t>(command.index_offset) + command.element_count > list.index_count
+                    || command.vertex_offset >= list.vertex_count)
+                    return false;
+                for(uint32_t i = 0; i < command.element_count; i++){
+                    ImDrawIdx index;
+                    memcpy(&index, index_data + (static_cast<size_t>(command.index_offset) + i) * sizeof(ImDrawIdx), sizeof(index));
+                    if(static_cast<uint64_t>(command.vertex_offset) + index >= list.vertex_count)
+                        return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    bool startRecording(const std::string& file_path){
+        stopRecording();
+        recording = fopen(file_path.c_str(), "wb");
+        if(!recording)
+            return false;
+        FileHeader header{};
+        memcpy(header.magic, file_magic, sizeof(file_magic));
+        header.version = file_version;
+        header.vertex_size = sizeof(ImDrawVert);
+        header.index_size = sizeof(ImDrawIdx);
+        fwrite(&header, sizeof(header), 1, recording);
+        return true;
+    }
+
+    void stopRecording(){
+        if(recording)
+            fclose(recording);
+        recording = nullptr;
+    }
+
+    bool isRecording(){
+        return recording != nullptr;
+    }
+
+    void captureFrame(const ImDrawData* draw_data){
+        if(!recording || !draw_data || !draw_data->Valid)
+            return;
+        PROFILE_ZONE("Capture draw data");
+        FrameHeader frame{
+            {draw_data->DisplayPos.x, draw_data->DisplayPos.y},
+            {draw_data->DisplaySize.x, draw_data->DisplaySize.y},
+            {draw_data->FramebufferScale.x, draw_data->FramebufferScale.y},
+            static_cast<uint32_t>(draw_data->CmdListsCount),
+            0
+        };
+        fwrite(&frame, sizeof(frame), 1, recording);
+        for(int i = 0; i < draw_data->CmdListsCount; i++){
+            const ImDrawList* list = draw_data->CmdLists[i];
+            ListHeader header{
+                static_cast<uint32_t>(list->VtxBuffer.Size),
+                static_cast<uint32_t>(list->IdxBuffer.Size),
+                static_cast<uint32_t>(list->CmdBuffer.Size),
+                static_cast<uint32_t>(list->Flags)
+            };
+            fwrite(&header, sizeof(header), 1, recording);
+            fwrite(list->VtxBuffer.Data, sizeof(ImDrawVert), list->VtxBuffer.Size, recording);
+            fwrite(list->IdxBuffer.Data, sizeof(ImDrawIdx), list->IdxBuffer.Size, recording);
+            for(const ImDrawCmd& cmd: list->CmdBuffer){
+                // User callbacks cannot be recorded; they are replayed as empty commands.
+                Command command{
+                    {cmd.ClipRect.x, cmd.ClipRect.y, cmd.ClipRect.z, cmd.ClipRect.w},
+                    static_cast<uint64_t>(reinterpret_cast<uintptr_t>(cmd.TextureId)),
+                    cmd.VtxOffset,
+                    cmd.IdxOffset,
+                    cmd.UserCallback ? 0 : cmd.ElemCount,
+                    0
+                };
+                fwrite(&command, sizeof(command), 1, recording);
+            }
+        }
+    }
+
+    bool Replay::open(const std::string& file_path){
+        bytes.clear();
+        frame_offsets.clear();
+        FILE* file = fopen(file_path.c_str(), "rb");
+        if(!file)
+            return false;
+        char buffer[64 * 1024];
+        size_t read;
+        while((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            bytes.insert(bytes.end(), buffer, buffer + read);
+        fclose(file);
+
+        FileHeader header;
+        if(bytes.size() < sizeof(header))
+            return false;
+        memcpy(&header, bytes.data(), sizeof(header));
+        if(memcmp(header.magic, file_magic, sizeof(file_magic)) != 0
+            || header.version != file_version
+            || header.vertex_size != sizeof(ImDrawVert)
+            || header.index_size != sizeof(ImDrawIdx)
+        )
+            return false;
+
+        // Walk the frames once to find where each one starts. A frame cut short at the end is dropped,
+        // while a command outside of its list's buffers makes the whole file unplayable.
+        size_t offset = sizeof(header);
+        while(offset + sizeof(FrameHeader) <= bytes.size()){
+            size_t frame_start = offset;
+            FrameHeader frame;
+            memcpy(&frame, bytes.data() + offset, sizeof(frame));
+            offset += sizeof(frame);
+            bool complete = true;
+            for(uint32_t i = 0; i < frame.list_count && complete; i++){
+                ListHeader list;
+                if(offset + sizeof(list) > bytes.size()){
+                    complete = false;
+                    break;
+                }
+                memcpy(&list, bytes.data() + offset, sizeof(list));
+                offset += sizeof(list);
+                const char* list_data = bytes.data() + offset;
+                offset += static_cast<size_t>(list.vertex_count) * sizeof(ImDrawVert)
+                    + static_cast<size_t>(list.index_count) * sizeof(ImDrawIdx)
+                    + static_cast<size_t>(list.command_count) * sizeof(Command);
+                complete = offset <= bytes.size();
+                if(complete && !commandsInRange(list_data, list)){
+                    frame_offsets.clear();
+                    return false;
+                }
+            }
+            if(!complete)
+                break;
+            frame_offsets.push_back(frame_start);
+        }
+        return true;
+    }
+
+    Replay::FrameStats Replay::stats(size_t frame_index) const {
+        FrameStats stats{};
+        size_t offset = frame_offsets[frame_index];
+        FrameHeader frame;
+        memcpy(&frame, bytes.data() + offset, sizeof(frame));
+        offset += sizeof(frame);
+        stats.draw_lists = frame.list_count;
+        for(uint32_t i = 0; i < frame.list_count; i++){
+            ListHeader list;
+            memcpy(&list, bytes.data() + offset, sizeof(list));
+            stats.vertices += list.vertex_count;
+            stats.indices += list.index_count;
+            stats.commands += list.command_count;
+            offset += sizeof(list)
+                + static_cast<size_t>(list.vertex_count) * sizeof(ImDrawVert)
+                + static_cast<size_t>(list.index_count) * sizeof(ImDrawIdx)
+                + static_cast<size_t>(list.command_count) * sizeof(Command);
+        }
+        return stats;
+    }
+
+    ImDrawData* Replay::frame(size_t frame_index, ImTextureID replacement_texture){
+        size_t offset = frame_offsets[frame_index];
+        FrameHeader frame;
+        memcpy(&frame, bytes.data() + offset, sizeof(frame));
+        offset += sizeof(frame);
+
+        // The draw lists are kept from frame to frame, so their buffers are only reallocated when a frame is bigger.
+        while(lists.size() < frame.list_count)
+            lists.push_back(std::make_unique<ImDrawList>(ImGui::GetDrawListSharedData()));
+        list_pointers.resize(frame.list_count);
+
+        int total_vertices = 0;
+        int total_indices = 0;
+        for(uint32_t i = 0; i < frame.list_count; i++){
+            ListHeader header;
+            memcpy(&header, bytes.data() + offset, sizeof(header));
+            offset += sizeof(header);
+
+            ImDrawList* list = lists[i].get();
+            list->Flags = static_cast<ImDrawListFlags>(header.flags);
+            list->VtxBuffer.resize(static_cast<int>(header.vertex_count));
+            memcpy(list->VtxBuffer.Data, bytes.data() + offset, header.vertex_count * sizeof(ImDrawVert));
+            offset += header.vertex_count * sizeof(ImDrawVert);
+            list->IdxBuffer.resize(static_cast<int>(header.index_count));
+            memcpy(list->IdxBuffer.Data, bytes.data() + offset, header.index_count * sizeof(ImDrawIdx));
+            offset += header.index_count * sizeof(ImDrawIdx);
+
+            list->CmdBuffer.resize(static_cast<int>(header.command_count));
+            for(uint32_t c = 0; c < header.command_count; c++){
+                Command command;
+                memcpy(&command, bytes.data() + offset, sizeof(command));
+                offset += sizeof(command);
+                ImDrawCmd& cmd = list->CmdBuffer[static_cast<int>(c)];
+                cmd = ImDrawCmd();
+                cmd.ClipRect = ImVec4(command.clip_rect[0], command.clip_rect[1], command.clip_rect[2], command.clip_rect[3]);
+                cmd.TextureId = replacement_texture;
+                cmd.VtxOffset = command.vertex_offset;
+                cmd.IdxOffset = command.index_offset;
+                cmd.ElemCount = command.element_count;
+            }
+            list_pointers[i] = list;
+            total_vertices += static_cast<int>(header.vertex_count);
+            total_indices += static_cast<int>(header.index_count);
+        }
+
+        draw_data.Clear();
+        draw_data.Valid = true;
+        draw_data.CmdLists = list_pointers.data();
+        draw_data.CmdListsCount = static_cast<int>(frame.list_count);
+        draw_data.TotalVtxCount = total_vertices;
+        draw_data.TotalIdxCount = total_indices;
+        draw_data.DisplayPos = ImVec2(frame.display_pos[0], frame.display_pos[1]);
+        draw_data.DisplaySize = ImVec2(frame.display_size[0], frame.display_size[1]);
+        draw_data.FramebufferScale = ImVec2(frame.framebuffer_scale[0], frame.framebuffer_scale[1]);
+        return &draw_data;
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * 2020 Jonathan Mendez
+ */
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "imgui.h"
+
+/**
+ * Record the ImDrawData of every frame to a file, and play it back to a renderer without running the UI that made it.
+ * A recording is a reproducible rendering workload: replaying it measures the renderer alone,
+ * and its vertex and index counts show when a change makes the UI heavier to draw.
+ */
+namespace DrawCapture {
+    /**
+     * Start writing every rendered frame to the file. Returns false if it cannot be opened.
+     */
+    bool startRecording(const std::string& file_path);
+    void stopRecording();
+    bool isRecording();
+
+    /**
+     * Called by ImGuiMain after ImGui::Render(). Does nothing unless recording.
+     */
+    void captureFrame(const ImDrawData* draw_data);
+
+    /**
+     * The frames of a recording, loaded into memory.
+     */
+    class Replay {
+        std::vector<char> bytes;
+        std::vector<size_t> frame_offsets;
+        std::vector<std::unique_ptr<ImDrawList>> lists;
+        std::vector<ImDrawList*> list_pointers;
+        ImDrawData draw_data;
+    public:
+        struct FrameStats {
+            uint32_t draw_lists;
+            uint32_t commands;
+            uint32_t vertices;
+            uint32_t indices;
+        };
+
+        /**
+         * Load a recording. Returns false if it is missing, damaged, or was made with other vertex or index types.
+         */
+        bool open(const std::string& file_path);
+
+        inline size_t frameCount() const
+        { return frame_offsets.size(); }
+
+        FrameStats stats(size_t frame) const;
+
+        /**
+         * Rebuild a frame for a renderer backend. Valid until the next call.
+         * Recorded texture ids belong to the run that recorded them, so every texture is drawn with replacement_texture.
+         * Must be called with an ImGui context current.
+         */
+        ImDrawData* frame(size_t frame, ImTextureID replacement_texture);
+    };
+}
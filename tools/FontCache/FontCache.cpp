@@ -0,0 +1,373 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "FontCache.hpp"
+#include "imgui_internal.h"
+#include "../Profiler/Profiler.hpp"
+
+namespace FontCache {
+    namespace {
+        constexpr char file_magic[8] = {'I', 'M', 'F', 'O', 'N', 'T', 'A', 'C'};
+        constexpr uint32_t file_version = 1;
+
+        struct FileHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t font_count;
+            uint64_t key;
+            int32_t tex_width;
+            int32_t tex_height;
+            float tex_uv_scale[2];
+            float tex_uv_white_pixel[2];
+            int32_t custom_rect_count;
+            int32_t custom_rect_id;
+        };
+
+        struct CustomRect {
+            uint32_t id;
+            uint16_t width, height;
+            uint16_t x, y;
+            float glyph_advance_x;
+            float glyph_offset[2];
+            // Index into ImFontAtlas::Fonts, or -1.
+            int32_t font;
+        };
+
+        struct FontHeader {
+            float font_size;
+            float ascent;
+            float descent;
+            float display_offset[2];
+            uint32_t fallback_char;
+            uint32_t ellipsis_char;
+            int32_t metrics_total_surface;
+            uint32_t glyph_count;
+        };
+
+        struct LazyRanges {
+            ImFont* font;
+            std::string font_file;
+            float size_pixels;
+            const ImWchar* ranges;
+            bool requested;
+            bool merged;
+        };
+
+        static std::vector<LazyRanges> lazy_ranges;
+
+        /**
+         * FNV-1a over 8 bytes at a time; font files can be megabytes and are hashed on every start.
+         */
+        struct Hasher {
+            uint64_t hash = 14695981039346656037ull;
+
+            void add(const void* data, size_t size){
+                auto bytes = static_cast<const unsigned char*>(data);
+                size_t words = size / 8;
+                for(size_t i = 0; i < words; i++){
+                    uint64_t word;
+                    memcpy(&word, bytes + i * 8, 8);
+                    hash = (hash ^ word) * 1099511628211ull;
+                }
+                for(size_t i = words * 8; i < size; i++)
+                    hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+
+            template<typename T>
+            void add(const T& value){
+                add(&value, sizeof(value));
+            }
+        };
+
+        int fontIndex(const ImFontAtlas* atlas, const ImFont* font){
+            for(int i = 0; i < atlas->Fonts.Size; i++)
+                if(atlas->Fonts[i] == font)
+                    return i;
+            return -1;
+        }
+
+        uint64_t atlasKey(const ImFontAtlas* atlas){
+            PROFILE_ZONE("Hash fonts");
+            Hasher hasher;
+            hasher.add(IMGUI_VERSION, strlen(IMGUI_VERSION));
+            hasher.add(sizeof(ImFontGlyph));
+            hasher.add(sizeof(ImWchar));
+            hasher.add(atlas->Flags);
+            hasher.add(atlas->TexDesiredWidth);
+            hasher.add(atlas->TexGlyphPadding);
+            hasher.add(atlas->Fonts.Size);
+            for(const ImFontConfig& config: atlas->ConfigData){
+                hasher.add(config.FontDataSize);
+                hasher.add(config.FontData, static_cast<size_t>(config.FontDataSize));
+                hasher.add(config.FontNo);
+                hasher.add(config.SizePixels);
+                hasher.add(config.OversampleH);
+                hasher.add(config.OversampleV);
+                hasher.add(config.PixelSnapH);
+                hasher.add(config.GlyphExtraSpacing);
+                hasher.add(config.GlyphOffset);
+                hasher.add(config.GlyphMinAdvanceX);
+                hasher.add(config.GlyphMaxAdvanceX);
+                hasher.add(config.MergeMode);
+                hasher.add(config.RasterizerFlags);
+                hasher.add(config.RasterizerMultiply);
+                hasher.add(config.EllipsisChar);
+                hasher.add(fontIndex(atlas, config.DstFont));
+                if(config.GlyphRanges)
+                    for(const ImWchar* range = config.GlyphRanges; *range; range++)
+                        hasher.add(*range);
+            }
+            // Rects added by the user; glyphs may be drawn into them. The one ImGui adds when building is left out,
+            // so that the key is the same before and after building.
+            for(int i = 0; i < atlas->CustomRects.Size; i++){
+                if(i == atlas->CustomRectIds[0])
+                    continue;
+                const ImFontAtlasCustomRect& rect = atlas->CustomRects[i];
+                hasher.add(rect.ID);
+                hasher.add(rect.Width);
+                hasher.add(rect.Height);
+                hasher.add(rect.GlyphAdvanceX);
+                hasher.add(rect.GlyphOffset);
+                hasher.add(fontIndex(atlas, rect.Font));
+            }
+            return hasher.hash;
+        }
+
+        bool readFile(const std::string& path, std::vector<char>& bytes){
+            FILE* file = fopen(path.c_str(), "rb");
+            if(!file)
+                return false;
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            bool read = size > 0;
+            if(read){
+                bytes.resize(static_cast<size_t>(size));
+                read = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+            }
+            fclose(file);
+            return read;
+        }
+
+        /**
+         * Reads consecutive values out of the file, failing once the end is passed.
+         */
+        struct Reader {
+            const std::vector<char>& bytes;
+            size_t offset = 0;
+            bool failed = false;
+
+            bool read(void* out, size_t size){
+                if(failed || offset + size > bytes.size())
+                    return !(failed = true);
+                memcpy(out, bytes.data() + offset, size);
+                offset += size;
+                return true;
+            }
+
+            /**
+             * Check that count records are left before sizing anything by a count read from the file.
+             */
+            bool hasRecords(uint64_t count, size_t record_size){
+                if(failed || count > (bytes.size() - offset) / record_size)
+                    return !(failed = true);
+                return true;
+            }
+        };
+    }
+
+    bool load(ImFontAtlas* atlas, const std::string& cache_file){
+        PROFILE_ZONE("Load font cache");
+        if(atlas->ConfigData.empty())
+            atlas->AddFontDefault();
+        std::vector<char> bytes;
+        if(!readFile(cache_file, bytes))
+            return false;
+        Reader reader{bytes};
+        FileHeader header;
+        if(!reader.read(&header, sizeof(header))
+            || memcmp(header.magic, file_magic, sizeof(file_magic)) != 0
+            || header.version != file_version
+            || header.key != atlasKey(atlas)
+            || static_cast<int>(header.font_count) != atlas->Fonts.Size
+            || header.tex_width <= 0 || header.tex_height <= 0
+        )
+            return false;
+
+        if(header.custom_rect_count < 0 || !reader.hasRecords(static_cast<uint64_t>(header.custom_rect_count), sizeof(CustomRect)))
+            return false;
+        std::vector<CustomRect> custom_rects(static_cast<size_t>(header.custom_rect_count));
+        reader.read(custom_rects.data(), custom_rects.size() * sizeof(CustomRect));
+        std::vector<FontHeader> fonts(header.font_count);
+        std::vector<std::vector<ImFontGlyph>> glyphs(header.font_count);
+        for(uint32_t i = 0; i < header.font_count; i++){
+            reader.read(&fonts[i], sizeof(FontHeader));
+            if(!reader.hasRecords(fonts[i].glyph_count, sizeof(ImFontGlyph)))
+                return false;
+            glyphs[i].resize(fonts[i].glyph_count);
+            reader.read(glyphs[i].data(), glyphs[i].size() * sizeof(ImFontGlyph));
+        }
+        size_t pixel_count = static_cast<size_t>(header.tex_width) * static_cast<size_t>(header.tex_height);
+        if(reader.failed || reader.offset + pixel_count > bytes.size())
+            return false;
+
+        // Everything is read; from here on the atlas is changed.
+        atlas->ClearTexData();
+        atlas->TexWidth = header.tex_width;
+        atlas->TexHeight = header.tex_height;
+        atlas->TexUvScale = ImVec2(header.tex_uv_scale[0], header.tex_uv_scale[1]);
+        atlas->TexUvWhitePixel = ImVec2(header.tex_uv_white_pixel[0], header.tex_uv_white_pixel[1]);
+        atlas->TexPixelsAlpha8 = static_cast<unsigned char*>(IM_ALLOC(pixel_count));
+        memcpy(atlas->TexPixelsAlpha8, bytes.data() + reader.offset, pixel_count);
+
+        atlas->CustomRects.resize(static_cast<int>(custom_rects.size()));
+        for(size_t i = 0; i < custom_rects.size(); i++){
+            ImFontAtlasCustomRect& rect = atlas->CustomRects[static_cast<int>(i)];
+            const CustomRect& saved = custom_rects[i];
+            rect.ID = saved.id;
+            rect.Width = saved.width;
+            rect.Height = saved.height;
+            rect.X = saved.x;
+            rect.Y = saved.y;
+            rect.GlyphAdvanceX = saved.glyph_advance_x;
+            rect.GlyphOffset = ImVec2(saved.glyph_offset[0], saved.glyph_offset[1]);
+            rect.Font = saved.font >= 0 && saved.font < atlas->Fonts.Size ? atlas->Fonts[saved.font] : nullptr;
+        }
+        atlas->CustomRectIds[0] = header.custom_rect_id;
+
+        for(int i = 0; i < atlas->Fonts.Size; i++){
+            ImFont* font = atlas->Fonts[i];
+            const FontHeader& saved = fonts[static_cast<size_t>(i)];
+            font->ClearOutputData();
+            font->FontSize = saved.font_size;
+            font->Ascent = saved.ascent;
+            font->Descent = saved.descent;
+            font->DisplayOffset = ImVec2(saved.display_offset[0], saved.display_offset[1]);
+            font->FallbackChar = static_cast<ImWchar>(saved.fallback_char);
+            font->EllipsisChar = static_cast<ImWchar>(saved.ellipsis_char);
+            font->MetricsTotalSurface = saved.metrics_total_surface;
+            font->ContainerAtlas = atlas;
+            font->ConfigData = nullptr;
+            font->ConfigDataCount = 0;
+            for(const ImFontConfig& config: atlas->ConfigData){
+                if(config.DstFont != font)
+                    continue;
+                if(!font->ConfigData)
+                    font->ConfigData = &config;
+                font->ConfigDataCount++;
+            }
+            auto& font_glyphs = glyphs[static_cast<size_t>(i)];
+            font->Glyphs.resize(static_cast<int>(font_glyphs.size()));
+            if(!font_glyphs.empty())
+                memcpy(font->Glyphs.Data, font_glyphs.data(), font_glyphs.size() * sizeof(ImFontGlyph));
+            font->BuildLookupTable();
+        }
+        return true;
+    }
+
+    bool save(ImFontAtlas* atlas, const std::string& cache_file){
+        PROFILE_ZONE("Save font cache");
+        if(atlas->ConfigData.empty())
+            atlas->AddFontDefault();
+        uint64_t key = atlasKey(atlas);
+        unsigned char* pixels;
+        int width, height;
+        atlas->GetTexDataAsAlpha8(&pixels, &width, &height);
+        if(!pixels)
+            return false;
+
+        std::string temp_file = cache_file + ".tmp";
+        FILE* file = fopen(temp_file.c_str(), "wb");
+        if(!file)
+            return false;
+        FileHeader header{};
+        memcpy(header.magic, file_magic, sizeof(file_magic));
+        header.version = file_version;
+        header.font_count = static_cast<uint32_t>(atlas->Fonts.Size);
+        header.key = key;
+        header.tex_width = width;
+        header.tex_height = height;
+        header.tex_uv_scale[0] = atlas->TexUvScale.x;
+        header.tex_uv_scale[1] = atlas->TexUvScale.y;
+        header.tex_uv_white_pixel[0] = atlas->TexUvWhitePixel.x;
+        header.tex_uv_white_pixel[1] = atlas->TexUvWhitePixel.y;
+        header.custom_rect_count = atlas->CustomRects.Size;
+        header.custom_rect_id = atlas->CustomRectIds[0];
+        fwrite(&header, sizeof(header), 1, file);
+        for(const ImFontAtlasCustomRect& rect: atlas->CustomRects){
+            CustomRect saved{
+                rect.ID, rect.Width, rect.Height, rect.X, rect.Y, rect.GlyphAdvanceX,
+                {rect.GlyphOffset.x, rect.GlyphOffset.y}, fontIndex(atlas, rect.Font)
+            };
+            fwrite(&saved, sizeof(saved), 1, file);
+        }
+        for(const ImFont* font: atlas->Fonts){
+            FontHeader saved{
+                font->FontSize, font->Ascent, font->Descent, {font->DisplayOffset.x, font->DisplayOffset.y},
+                font->FallbackChar, font->EllipsisChar, font->MetricsTotalSurface, static_cast<uint32_t>(font->Glyphs.Size)
+            };
+            fwrite(&saved, sizeof(saved), 1, file);
+            fwrite(font->Glyphs.Data, sizeof(ImFontGlyph), static_cast<size_t>(font->Glyphs.Size), file);
+        }
+        fwrite(pixels, 1, static_cast<size_t>(width) * static_cast<size_t>(height), file);
+        bool written = ferror(file) == 0;
+        fclose(file);
+        if(!written || rename(temp_file.c_str(), cache_file.c_str()) != 0){
+            remove(temp_file.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void addLazyRanges(ImFont* font, const std::string& font_file, float size_pixels, const ImWchar* ranges){
+        lazy_ranges.push_back({font, font_file, size_pixels, ranges, false, false});
+    }
+
+    void requestGlyphs(const char* text, const char* text_end){
+        if(lazy_ranges.empty())
+            return;
+        if(!text_end)
+            text_end = text + strlen(text);
+        while(text < text_end){
+            if(static_cast<unsigned char>(*text) < 0x80){
+                text++;
+                continue;
+            }
+            unsigned int c;
+            text += ImTextCharFromUtf8(&c, text, text_end);
+            if(c == 0)
+                break;
+            for(LazyRanges& lazy: lazy_ranges){
+                if(lazy.requested)
+                    continue;
+                for(const ImWchar* range = lazy.ranges; range[0] && range[1]; range += 2){
+                    if(c >= range[0] && c <= range[1]){
+                        lazy.requested = !lazy.font->FindGlyphNoFallback(static_cast<ImWchar>(c));
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    bool update(ImFontAtlas* atlas){
+        bool added = false;
+        for(LazyRanges& lazy: lazy_ranges){
+            if(!lazy.requested || lazy.merged)
+                continue;
+            ImFontConfig config;
+            config.MergeMode = true;
+            config.DstFont = lazy.font;
+            if(atlas->AddFontFromFileTTF(lazy.font_file.c_str(), lazy.size_pixels, &config, lazy.ranges))
+                added = true;
+            else
+                fprintf(stderr, "FontCache: failed to load %s\n", lazy.font_file.c_str());
+            lazy.merged = true;
+        }
+        if(!added)
+            return false;
+        PROFILE_ZONE("Build lazy glyph ranges");
+        return atlas->Build();
+    }
+}
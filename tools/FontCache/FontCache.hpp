@@ -0,0 +1,44 @@
+/**
+ * 2020 Jonathan Mendez
+ */
+#pragma once
+#include <string>
+#include "imgui.h"
+
+/**
+ * Keep a built font atlas in a file, so that later runs load the glyphs instead of rasterizing them again,
+ * and only rasterize rarely used glyph ranges when text needs them.
+ * The file is keyed by everything the atlas is built from (font data, sizes, glyph ranges, options),
+ * so changing any of them rebuilds the atlas instead of loading a stale one.
+ */
+namespace FontCache {
+    /**
+     * Restore the atlas from the file if it was saved from the same fonts. Call after adding the fonts.
+     * With no fonts added, the default font is added first, as ImGui would when building.
+     * Returns false if the atlas still has to be built.
+     */
+    bool load(ImFontAtlas* atlas, const std::string& cache_file);
+
+    /**
+     * Build the atlas if needed, and save it to the file.
+     */
+    bool save(ImFontAtlas* atlas, const std::string& cache_file);
+
+    /**
+     * Merge the ranges from a font file into font, but only once text that needs them is passed to requestGlyphs().
+     * For scripts that are rarely shown, e.g. CJK, which would make the atlas much bigger and slower to build.
+     * ranges has to stay valid (e.g. one of the GetGlyphRanges*() tables or a static array).
+     */
+    void addLazyRanges(ImFont* font, const std::string& font_file, float size_pixels, const ImWchar* ranges);
+
+    /**
+     * Tell the cache about text about to be shown, from the thread running ImGui. Lazy ranges with glyphs the text uses are merged on the next update().
+     */
+    void requestGlyphs(const char* text, const char* text_end = nullptr);
+
+    /**
+     * Called by ImGuiMain before a frame. Returns true when the atlas was rebuilt with lazy ranges,
+     * and its texture has to be uploaded again.
+     */
+    bool update(ImFontAtlas* atlas);
+}
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+#include "FrameCapture.hpp"
+#include "../Profiler/Profiler.hpp"
+
+#include "stb/stb_image_write.h" // Implemented in ImageLoad.cpp
+
+#include "GL/gl3w.h"
+#include "GLFW/glfw3.h"
+
+#include "../TP/TP.hpp"
+
+namespace FrameCapture {
+    namespace {
+        struct Request {
+            std::string file_path;
+            Format format;
+            int jpeg_quality;
+        };
+
+        /**
+         * A pixel buffer object that a frame is read back into.
+         */
+        struct Slot {
+            GLuint pbo{};
+            GLsync fence{};
+            size_t capacity{};
+            int width{};
+            int height{};
+            int frames_waited{};
+            bool busy{};
+            Request request;
+        };
+
+        // Enough slots to cover the frames the gpu can queue up before the pixels of a capture are available.
+        constexpr size_t num_slots = 3;
+        // The most frames waiting to be encoded at once. Recording drops frames past this.
+        constexpr int max_pending_encodes = 8;
+
+        static Slot slots[num_slots];
+        static std::deque<Request> screenshots;
+        static std::atomic<int> pending_encodes{0};
+        static size_t dropped_frames = 0;
+
+        static bool recording = false;
+        static std::string recording_prefix;
+        static Format recording_format;
+        static int recording_quality;
+        static double recording_interval;
+        static double next_recording_time;
+        static size_t recording_frame;
+
+        inline bool haveFences(){
+            static bool supported = gl3wIsSupported(3, 2);
+            return supported;
+        }
+
+        Format formatFromPath(const std::string& file_path){
+            auto dot = file_path.find_last_of('.');
+            if(dot == std::string::npos)
+                return Format::PNG;
+            std::string ext = file_path.substr(dot + 1);
+            for(auto& c: ext)
+                c = static_cast<char>(tolower(c));
+            if(ext == "jpg" || ext == "jpeg")
+                return Format::JPEG;
+            return Format::PNG;
+        }
+
+        void encode(std::vector<uint8_t> pixels, int width, int height, Request request){
+            PROFILE_ZONE("Encode frame");
+            // OpenGL reads the bottom row first, and the alpha of the back buffer is not meaningful.
+            size_t stride = static_cast<size_t>(width) * 4;
+            std::vector<uint8_t> row(stride);
+            for(int y = 0; y < height / 2; y++){
+                uint8_t* top = pixels.data() + y * stride;
+                uint8_t* bottom = pixels.data() + (height - 1 - y) * stride;
+                memcpy(row.data(), top, stride);
+                memcpy(top, bottom, stride);
+                memcpy(bottom, row.data(), stride);
+            }
+            for(size_t i = 3; i < pixels.size(); i += 4)
+                pixels[i] = 0xFF;
+
+            int ok = 0;
+            if(request.format == Format::JPEG)
+                ok = stbi_write_jpg(request.file_path.c_str(), width, height, 4, pixels.data(), request.jpeg_quality);
+            else
+                ok = stbi_write_png(request.file_path.c_str(), width, height, 4, pixels.data(), static_cast<int>(stride));
+            if(!ok)
+                fprintf(stderr, "FrameCapture: Could not write %s\n", request.file_path.c_str());
+        }
+
+        bool slotReady(Slot& slot){
+            if(!slot.fence)
+                return ++slot.frames_waited > static_cast<int>(num_slots);
+            GLenum status = glClientWaitSync(slot.fence, 0, 0);
+            return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+        }
+
+        /**
+         * Hand every read back that the gpu has finished over to the encoders.
+         */
+        void collect(){
+            for(auto& slot: slots){
+                if(!slot.busy || !slotReady(slot))
+                    continue;
+
+                size_t size = static_cast<size_t>(slot.width) * slot.height * 4;
+                std::vector<uint8_t> pixels(size);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+                if(void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT)){
+                    memcpy(pixels.data(), mapped, size);
+                    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                } else {
+                    pixels.clear();
+                }
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+                if(slot.fence)
+                    glDeleteSync(slot.fence);
+                slot.fence = 0;
+                slot.busy = false;
+
+                if(pixels.empty()){
+                    pending_encodes--;
+                    continue;
+                }
+                TP::add_job([pixels = std::move(pixels), width = slot.width, height = slot.height, request = std::move(slot.request)]() mutable {
+                    encode(std::move(pixels), width, height, std::move(request));
+                    pending_encodes--;
+                });
+            }
+        }
+
+        /**
+         * Start an asynchronous read back of the current frame. Returns false when there is no room for it.
+         */
+        bool readBack(int width, int height, Request request){
+            if(pending_encodes >= max_pending_encodes)
+                return false;
+            auto slot = std::find_if(std::begin(slots), std::end(slots), [](const Slot& slot){
+                return !slot.busy;
+            });
+            if(slot == std::end(slots))
+                return false;
+
+            size_t size = static_cast<size_t>(width) * height * 4;
+            if(!slot->pbo)
+                glGenBuffers(1, &slot->pbo);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+            if(slot->capacity < size){
+                glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+                slot->capacity = size;
+            }
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            // With a pack buffer bound, this only queues the copy instead of waiting for the frame to finish.
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+            slot->fence = haveFences() ? glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) : 0;
+            slot->width = width;
+            slot->height = height;
+            slot->frames_waited = 0;
+            slot->busy = true;
+            slot->request = std::move(request);
+            pending_encodes++;
+            return true;
+        }
+    }
+
+    void screenshot(const std::string& file_path){
+        screenshots.push_back({file_path, formatFromPath(file_path), 90});
+    }
+
+    void startRecording(const std::string& path_prefix, float fps, Format format, int jpeg_quality){
+        recording = true;
+        recording_prefix = path_prefix;
+        recording_format = format;
+        recording_quality = jpeg_quality;
+        recording_interval = fps > 0.0f ? 1.0 / fps : 0.0;
+        next_recording_time = glfwGetTime();
+        recording_frame = 0;
+        dropped_frames = 0;
+    }
+
+    void stopRecording(){
+        recording = false;
+    }
+
+    bool isRecording(){
+        return recording;
+    }
+
+    size_t droppedFrames(){
+        return dropped_frames;
+    }
+
+    void captureFrame(int width, int height){
+        collect();
+        if(width <= 0 || height <= 0)
+            return;
+
+        // A screenshot stays queued until there is room for it.
+        if(!screenshots.empty() && readBack(width, height, screenshots.front()))
+            screenshots.pop_front();
+
+        if(!recording)
+            return;
+        double now = glfwGetTime();
+        if(now < next_recording_time)
+            return;
+        // Do not try to catch up on missed frames all at once.
+        next_recording_time = std::max(next_recording_time + recording_interval, now);
+
+        char frame_number[16];
+        snprintf(frame_number, sizeof(frame_number), "_%06zu", recording_frame++);
+        Request request{
+            recording_prefix + frame_number + (recording_format == Format::JPEG ? ".jpg" : ".png"),
+            recording_format,
+            recording_quality
+        };
+        if(!readBack(width, height, std::move(request)))
+            dropped_frames++;
+    }
+
+    void shutdown(){
+        recording = false;
+        screenshots.clear();
+        for(auto& slot: slots){
+            if(slot.fence)
+                glDeleteSync(slot.fence);
+            if(slot.pbo)
+                glDeleteBuffers(1, &slot.pbo);
+            if(slot.busy)
+                pending_encodes--;
+            slot = Slot{};
+        }
+    }
+}
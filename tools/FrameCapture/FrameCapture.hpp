@@ -0,0 +1,47 @@
+/**
+ * 2020 Jonathan Mendez
+ */
+#pragma once
+#include <cstddef>
+#include <string>
+
+/**
+ * Save what is rendered in the ImGuiMain window to image files.
+ * Pixels are read back through pixel buffer objects and only mapped once the gpu is done with them,
+ * so capturing never waits on the gpu. Encoding happens on the thread pool.
+ * All functions must be called from the thread that renders (e.g. inside of imgui_calls).
+ */
+namespace FrameCapture {
+    enum class Format {
+        PNG,
+        JPEG
+    };
+
+    /**
+     * Save the next rendered frame. The format is picked from the extension (.jpg/.jpeg, otherwise png).
+     */
+    void screenshot(const std::string& file_path);
+
+    /**
+     * Save frames at the given rate as "<path_prefix>_<frame number>.<png|jpg>" until stopRecording() is called.
+     * When the encoders fall behind, frames are dropped instead of slowing down rendering.
+     */
+    void startRecording(const std::string& path_prefix, float fps, Format format = Format::JPEG, int jpeg_quality = 90);
+    void stopRecording();
+    bool isRecording();
+
+    /**
+     * The number of frames skipped while recording because the capture queue was full.
+     */
+    size_t droppedFrames();
+
+    /**
+     * Called by ImGuiMain after a frame is rendered and before the buffers are swapped.
+     */
+    void captureFrame(int width, int height);
+
+    /**
+     * Release the gpu resources. Captures that have not been read back yet are discarded.
+     */
+    void shutdown();
+}
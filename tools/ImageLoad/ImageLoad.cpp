@@ -23,24 +23,33 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 
  */
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
 #include <iostream>
 #include <string>
 #include <queue>
+#include <unordered_map>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 #include "ImageLoad.hpp"
 
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
 #include "stb/stb_image.h"
 #include "stb/stb_image_write.h"
+#include "stb/stb_image_resize.h"
 
 #include "GL/gl3w.h"
 #include "GLFW/glfw3.h"
 
+#include "../Profiler/Profiler.hpp"
 #include "../TP/TP.hpp"
+#include "../Redraw/Redraw.hpp"
 
 namespace GPUTexture {
     void openGLUpload(ImageRID& rid, int width, int height, int num_channels, const uint8_t* bytes){
@@ -98,21 +107,88 @@ namespace GPUTexture {
         glDeleteTextures(1, (GLuint*)&rid);
     }
 
+    namespace DeletionQueue {
+        namespace {
+            struct Batch {
+                GLsync fence;
+                int frames_waited;
+                std::vector<GLuint> handles;
+            };
+
+            // Without fences, assume the gpu is never more than this many frames behind.
+            constexpr int max_frames_in_flight = 3;
+
+            static std::mutex incoming_mutex;
+            static std::vector<GLuint> incoming;
+            static std::deque<Batch> batches;
+
+            inline bool haveFences(){
+                static bool supported = gl3wIsSupported(3, 2);
+                return supported;
+            }
+
+            void deleteBatch(Batch& batch){
+                glDeleteTextures(static_cast<GLsizei>(batch.handles.size()), batch.handles.data());
+                if(batch.fence)
+                    glDeleteSync(batch.fence);
+            }
+        }
+
+        void enqueue(ImageRID rid){
+            if(rid == 0)
+                return;
+            std::lock_guard<std::mutex> lock{incoming_mutex};
+            incoming.push_back(static_cast<GLuint>(rid));
+        }
+
+        void collect(){
+            // Batches are fenced in order, so stop at the first one the gpu has not finished.
+            while(!batches.empty()){
+                Batch& batch = batches.front();
+                if(batch.fence){
+                    GLenum status = glClientWaitSync(batch.fence, 0, 0);
+                    if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                        break;
+                } else if(++batch.frames_waited <= max_frames_in_flight){
+                    break;
+                }
+                deleteBatch(batch);
+                batches.pop_front();
+            }
+
+            Batch batch{};
+            {
+                std::lock_guard<std::mutex> lock{incoming_mutex};
+                if(incoming.empty())
+                    return;
+                batch.handles.swap(incoming);
+            }
+            batch.fence = haveFences() ? glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) : 0;
+            batches.push_back(std::move(batch));
+        }
+
+        void flush(){
+            {
+                std::lock_guard<std::mutex> lock{incoming_mutex};
+                batches.push_back(Batch{0, 0, std::move(incoming)});
+                incoming.clear();
+            }
+            glFinish();
+            for(auto& batch: batches)
+                deleteBatch(batch);
+            batches.clear();
+        }
+    }
+
     namespace SideLoader {
         static std::mutex gl_ctx_mutex;
         static GLFWwindow* texture_sideload_ctx = nullptr;
 
+        // Jobs added before the context exists; they are started once it is created.
+        static std::mutex pending_jobs_mutex;
+        static std::vector<GPUTextureJob> pending_jobs;
 
-        void create_context() {
-            if(texture_sideload_ctx)
-                return; // Has already been successfully created.
-
-            // Create a seperate glfw context and share texture resources with the current context.
-            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-            texture_sideload_ctx = glfwCreateWindow(640, 480, "Texture sideloader.", NULL, glfwGetCurrentContext());
-        }
-        
-        void add_job(GPUTextureJob job){
+        void run_job(GPUTextureJob job){
             TP::add_job(
                 [job = std::move(job)](){
                     std::lock_guard<std::mutex> lock{gl_ctx_mutex};
@@ -122,6 +198,180 @@ namespace GPUTexture {
                 }
             );
         }
+
+        void create_context() {
+            std::vector<GPUTextureJob> jobs;
+            {
+                std::lock_guard<std::mutex> lock{pending_jobs_mutex};
+                if(texture_sideload_ctx)
+                    return; // Has already been successfully created.
+
+                // Create a seperate glfw context and share texture resources with the current context.
+                glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+                texture_sideload_ctx = glfwCreateWindow(640, 480, "Texture sideloader.", NULL, glfwGetCurrentContext());
+                if(!texture_sideload_ctx)
+                    return;
+                jobs.swap(pending_jobs);
+            }
+            for(auto& job: jobs)
+                run_job(std::move(job));
+        }
+        
+        void add_job(GPUTextureJob job){
+            {
+                std::lock_guard<std::mutex> lock{pending_jobs_mutex};
+                if(!texture_sideload_ctx){
+                    pending_jobs.push_back(std::move(job));
+                    return;
+                }
+            }
+            run_job(std::move(job));
+        }
+    }
+}
+
+namespace ImageProbe {
+    namespace {
+        struct CacheEntry {
+            std::filesystem::file_time_type mtime;
+            bool valid;
+            ImageInfo info;
+        };
+
+        static std::mutex cache_mutex;
+        static std::unordered_map<std::string, CacheEntry> cache;
+
+        // Enough for the headers of most images. Images with large metadata blocks before their size get a bigger read.
+        constexpr size_t header_read_size = 4 * 1024;
+        constexpr size_t header_read_limit = 1024 * 1024;
+
+        ImageFormat detectFormat(const uint8_t* header, size_t size){
+            auto starts_with = [&](const char* magic){
+                size_t magic_len = strlen(magic);
+                return size >= magic_len && memcmp(header, magic, magic_len) == 0;
+            };
+            if(starts_with("\x89PNG"))
+                return ImageFormat::PNG;
+            if(starts_with("\xFF\xD8"))
+                return ImageFormat::JPEG;
+            if(starts_with("GIF8"))
+                return ImageFormat::GIF;
+            if(starts_with("BM"))
+                return ImageFormat::BMP;
+            if(starts_with("8BPS"))
+                return ImageFormat::PSD;
+            if(starts_with("#?RADIANCE") || starts_with("#?RGBE"))
+                return ImageFormat::HDR;
+            if(starts_with("\x53\x80\xF6\x34"))
+                return ImageFormat::PIC;
+            if(starts_with("P5") || starts_with("P6"))
+                return ImageFormat::PNM;
+            // TGA has no magic number; stb_image only tries it after every other format.
+            return ImageFormat::TGA;
+        }
+
+        bool readHeader(const std::string& image_location, ImageInfo& info){
+            FILE* image_file = fopen(image_location.c_str(), "rb");
+            if(image_file == nullptr)
+                return false;
+
+            bool found = false;
+            std::vector<uint8_t> header;
+            size_t header_size = 0;
+            for(size_t read_size = header_read_size; read_size <= header_read_limit; read_size *= 16){
+                header.resize(read_size);
+                header_size += fread(header.data() + header_size, 1, read_size - header_size, image_file);
+                if(stbi_info_from_memory(header.data(), static_cast<int>(header_size), &info.width, &info.height, &info.num_channels)){
+                    info.format = detectFormat(header.data(), header_size);
+                    found = true;
+                    break;
+                }
+                if(header_size < read_size)
+                    break; // The whole file has been read.
+            }
+
+            fclose(image_file);
+            return found;
+        }
+    }
+
+    bool probe(const std::string& image_location, ImageInfo& info){
+        std::error_code ec;
+        auto mtime = std::filesystem::last_write_time(image_location, ec);
+        if(ec)
+            return false;
+
+        {
+            std::lock_guard<std::mutex> lock{cache_mutex};
+            auto it = cache.find(image_location);
+            if(it != cache.end() && it->second.mtime == mtime){
+                info = it->second.info;
+                return it->second.valid;
+            }
+        }
+
+        ImageInfo probed;
+        bool valid = readHeader(image_location, probed);
+        {
+            std::lock_guard<std::mutex> lock{cache_mutex};
+            cache[image_location] = CacheEntry{mtime, valid, probed};
+        }
+        info = probed;
+        return valid;
+    }
+
+    void probeAsync(std::vector<std::string> image_locations, std::function<void(std::vector<ImageInfo>)> on_done){
+        struct Batch {
+            std::vector<std::string> locations;
+            std::vector<ImageInfo> infos;
+            std::function<void(std::vector<ImageInfo>)> on_done;
+            std::atomic<size_t> jobs_left;
+        };
+        auto batch = std::make_shared<Batch>();
+        batch->infos.resize(image_locations.size());
+        batch->locations = std::move(image_locations);
+        batch->on_done = std::move(on_done);
+
+        size_t count = batch->locations.size();
+        if(count == 0){
+            batch->on_done({});
+            return;
+        }
+        // Split the work so every thread gets a few jobs, without making jobs so small that queueing dominates.
+        size_t num_jobs = std::max(1u, std::thread::hardware_concurrency()) * 4;
+        size_t job_size = std::max<size_t>(64, (count + num_jobs - 1) / num_jobs);
+        num_jobs = (count + job_size - 1) / job_size;
+        batch->jobs_left = num_jobs;
+
+        for(size_t begin = 0; begin < count; begin += job_size){
+            size_t end = std::min(count, begin + job_size);
+            TP::add_job([batch, begin, end](){
+                for(size_t i = begin; i < end; i++){
+                    if(!probe(batch->locations[i], batch->infos[i]))
+                        batch->infos[i] = ImageInfo{};
+                }
+                if(--batch->jobs_left == 0)
+                    batch->on_done(std::move(batch->infos));
+            });
+        }
+    }
+
+    void clearCache(){
+        std::lock_guard<std::mutex> lock{cache_mutex};
+        cache.clear();
+    }
+
+    bool hasImageExtension(std::string_view extension){
+        static const char* extensions[] = {
+            ".png", ".jpg", ".jpeg", ".gif", ".bmp", ".psd", ".tga", ".hdr", ".pic", ".pnm", ".ppm", ".pgm"
+        };
+        for(auto candidate: extensions){
+            if(extension.size() == strlen(candidate) && std::equal(extension.begin(), extension.end(), candidate, [](char a, char b){
+                return tolower(static_cast<unsigned char>(a)) == b;
+            }))
+                return true;
+        }
+        return false;
     }
 }
 
@@ -133,9 +383,7 @@ ImagePixelData::ImagePixelData(ImagePixelData&& move_data)
 }
 
 void Texture::free() {
-    GPUTexture::SideLoader::add_job([handle = handle](){
-        GPUTexture::openGLFree(handle);
-    });
+    GPUTexture::DeletionQueue::enqueue(handle);
     handle = 0;
 }
 
@@ -171,11 +419,45 @@ std::unique_ptr<uint8_t, ImagePixelData::D> ImagePixelData::movePixelBytes() {
     return std::move(pixel_bytes);
 }
 
-ImagePixelData::ImagePixelData(const std::string& image_location, bool flip) {
-    this->load(*this, image_location, flip);
+ImagePixelData::ImagePixelData(const std::string& image_location, bool flip, TargetSize target_size) {
+    this->load(*this, image_location, flip, target_size);
+}
+
+/**
+ * Downscale the pixel bytes so that the image fits inside of the target size, keeping its aspect ratio.
+ * stb_image has no way of decoding at a reduced scale, so the full image is decoded first and then resampled here.
+ */
+void ImagePixelData::shrinkToFit(ImagePixelData& image, TargetSize target_size) {
+    if(!image.pixel_bytes || target_size.width <= 0 || target_size.height <= 0)
+        return;
+    float scale = std::min(
+        static_cast<float>(target_size.width) / image.width,
+        static_cast<float>(target_size.height) / image.height
+    );
+    if(scale >= 1.0f)
+        return; // The image already fits.
+
+    int width = std::max(1, static_cast<int>(image.width * scale + 0.5f));
+    int height = std::max(1, static_cast<int>(image.height * scale + 0.5f));
+    // Allocate with stb's allocator so that D can free the bytes like any other decoded image.
+    uint8_t* bytes = static_cast<uint8_t*>(STBI_MALLOC(width*height*image.num_channels));
+    if(!bytes)
+        return;
+    if(!stbir_resize_uint8(
+        image.pixel_bytes.get(), image.width, image.height, 0,
+        bytes, width, height, 0,
+        image.num_channels
+    )){
+        stbi_image_free(bytes);
+        return;
+    }
+    image.pixel_bytes.reset(bytes);
+    image.width = width;
+    image.height = height;
 }
 
-void ImagePixelData::load(ImagePixelData& image, const std::string& image_location, bool flip) {
+void ImagePixelData::load(ImagePixelData& image, const std::string& image_location, bool flip, TargetSize target_size) {
+    PROFILE_ZONE("Decode image");
     FILE* image_file = fopen(image_location.c_str(), "rb");
     if(image_file == nullptr)
         return;
@@ -189,14 +471,18 @@ void ImagePixelData::load(ImagePixelData& image, const std::string& image_locati
     );
 
     fclose(image_file);
+
+    shrinkToFit(image, target_size);
 }
 
 void Texture::upload(Texture& texture) {
+    PROFILE_ZONE("Upload texture");
     if(!texture.image_data->pixel_bytes)
         return; // There is no image data to upload to the gpu.
     if(!glfwGetCurrentContext())
         return; // There is no open gl context, therefore we cannot upload the texture data.
-    GPUTexture::openGLFree(texture.handle);
+    // The old texture may still be in use by a frame the gpu has not finished.
+    GPUTexture::DeletionQueue::enqueue(texture.handle);
     GPUTexture::openGLUpload(
         texture.handle,
         texture.image_data->width,
@@ -207,9 +493,14 @@ void Texture::upload(Texture& texture) {
     texture.image_data->pixel_bytes.reset();
 }
 
-void Texture::uploadAsync(std::shared_ptr<Texture> texture) {
-    GPUTexture::SideLoader::add_job([texture = std::move(texture)](){
+void Texture::uploadAsync(std::shared_ptr<Texture> texture, std::function<void()> on_uploaded) {
+    GPUTexture::SideLoader::add_job([texture = std::move(texture), on_uploaded = std::move(on_uploaded)](){
         Texture::upload(*texture);
+        if(on_uploaded){
+            // The texture is drawn from another context; make sure the upload is complete before handing it over.
+            glFinish();
+            on_uploaded();
+        }
     });
 }
 
@@ -238,6 +529,7 @@ Texture::Texture()
 
 Texture::Texture(ImagePixelData&& image)
     : image_data{std::make_unique<ImagePixelData>(std::move(image))}
+    , handle{ }
 {}
 
 Texture::~Texture() {
@@ -248,3 +540,231 @@ Texture& Texture::operator=(Texture assign){
     std::swap(*this, assign);
     return *this;
 }
+
+
+struct AnimatedTexture::Stream {
+    struct Slot {
+        ImageRID handle{};
+        int delay_ms{};
+    };
+
+    mutable std::mutex mutex;
+    std::vector<Slot> slots;
+    size_t read_slot{};   // The slot being shown.
+    size_t ready_count{}; // Slots holding a frame, starting at read_slot.
+    bool decoding{};
+    bool stopped{};
+    bool failed{};
+    bool single_frame{};
+    int width{};
+    int height{};
+
+    // Decoder state. Only touched by the one decode job in flight.
+    std::vector<uint8_t> file_bytes;
+    stbi__context ctx;
+    stbi__gif gif;
+    int frame_index{};
+    std::vector<uint8_t> previous_frames[2]; // Needed for frames that dispose back to the frame before them.
+    std::vector<uint8_t> pixels;
+
+    Stream() {
+        memset(&gif, 0, sizeof(gif));
+    }
+
+    ~Stream() {
+        resetDecoder();
+    }
+
+    void resetDecoder() {
+        STBI_FREE(gif.out);
+        STBI_FREE(gif.history);
+        STBI_FREE(gif.background);
+        memset(&gif, 0, sizeof(gif));
+        stbi__start_mem(&ctx, file_bytes.data(), static_cast<int>(file_bytes.size()));
+        frame_index = 0;
+    }
+
+    /**
+     * Decode the next frame into pixels, starting over at the end of the animation.
+     * Returns the frame delay in milliseconds, or -1 on failure.
+     */
+    int decodeNext() {
+        for(int attempt = 0; attempt < 2; attempt++){
+            int comp;
+            uint8_t* two_back = frame_index >= 2 ? previous_frames[frame_index % 2].data() : nullptr;
+            uint8_t* frame = stbi__gif_load_next(&ctx, &gif, &comp, 4, two_back);
+            if(frame == reinterpret_cast<uint8_t*>(&ctx)){
+                // The end of the animation.
+                if(frame_index == 1){
+                    single_frame = true;
+                    return -1;
+                }
+                resetDecoder();
+                continue;
+            }
+            if(!frame)
+                return -1;
+
+            size_t frame_size = static_cast<size_t>(gif.w) * gif.h * 4;
+            pixels.assign(frame, frame + frame_size);
+            previous_frames[frame_index % 2].assign(frame, frame + frame_size);
+            frame_index++;
+            // Browsers treat very small delays as a default delay; do the same.
+            return gif.delay < 20 ? 100 : gif.delay;
+        }
+        return -1;
+    }
+
+    /**
+     * Must be called with the mutex held once no decode job is in flight.
+     */
+    void freeSlots() {
+        for(auto& slot: slots){
+            GPUTexture::DeletionQueue::enqueue(slot.handle);
+            slot.handle = 0;
+        }
+    }
+};
+
+AnimatedTexture::AnimatedTexture(const std::string& image_location, size_t ring_size)
+    : stream{std::make_shared<Stream>()}
+    , frame_elapsed{}
+{
+    // At least two slots are needed so that the next frame can be decoded while one is shown.
+    stream->slots.resize(std::max<size_t>(2, ring_size));
+
+    FILE* image_file = fopen(image_location.c_str(), "rb");
+    if(image_file == nullptr){
+        stream->failed = true;
+        return;
+    }
+    fseek(image_file, 0, SEEK_END);
+    long file_size = ftell(image_file);
+    fseek(image_file, 0, SEEK_SET);
+    if(file_size > 0){
+        stream->file_bytes.resize(file_size);
+        stream->file_bytes.resize(fread(stream->file_bytes.data(), 1, file_size, image_file));
+    }
+    fclose(image_file);
+
+    stbi__start_mem(&stream->ctx, stream->file_bytes.data(), static_cast<int>(stream->file_bytes.size()));
+    if(!stbi__gif_test(&stream->ctx)){
+        stream->failed = true;
+        return;
+    }
+    stream->resetDecoder();
+    fill(stream);
+}
+
+AnimatedTexture::~AnimatedTexture() {
+    std::lock_guard<std::mutex> lock{stream->mutex};
+    stream->stopped = true;
+    if(!stream->decoding)
+        stream->freeSlots(); // Otherwise the job in flight frees them when it sees the stream was stopped.
+}
+
+/**
+ * Start decoding the next frame if there is a free slot in the ring and no decode is in flight.
+ */
+void AnimatedTexture::fill(std::shared_ptr<Stream> stream) {
+    size_t write_slot;
+    {
+        std::lock_guard<std::mutex> lock{stream->mutex};
+        if(stream->stopped || stream->failed || stream->single_frame || stream->decoding)
+            return;
+        if(stream->ready_count == stream->slots.size())
+            return;
+        write_slot = (stream->read_slot + stream->ready_count) % stream->slots.size();
+        stream->decoding = true;
+    }
+
+    TP::add_job([stream = std::move(stream), write_slot](){
+        int delay_ms = stream->decodeNext();
+        if(delay_ms < 0){
+            std::lock_guard<std::mutex> lock{stream->mutex};
+            stream->decoding = false;
+            stream->failed = !stream->single_frame;
+            if(stream->stopped)
+                stream->freeSlots();
+            return;
+        }
+
+        GPUTexture::SideLoader::add_job([stream, write_slot, delay_ms](){
+            ImageRID handle = stream->slots[write_slot].handle;
+            if(handle == 0) {
+                GPUTexture::openGLUpload(handle, stream->gif.w, stream->gif.h, 4, stream->pixels.data());
+            } else {
+                // Reuse the texture that was allocated the first time around the ring.
+                glBindTexture(GL_TEXTURE_2D, handle);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, stream->gif.w, stream->gif.h, GL_RGBA, GL_UNSIGNED_BYTE, stream->pixels.data());
+                glGenerateMipmap(GL_TEXTURE_2D);
+                glBindTexture(GL_TEXTURE_2D, 0);
+            }
+            // The frame is shown from another context; make sure the upload is complete before handing it over.
+            glFinish();
+
+            {
+                std::lock_guard<std::mutex> lock{stream->mutex};
+                stream->slots[write_slot] = Stream::Slot{handle, delay_ms};
+                stream->width = stream->gif.w;
+                stream->height = stream->gif.h;
+                stream->decoding = false;
+                if(stream->stopped){
+                    stream->freeSlots();
+                    return;
+                }
+                stream->ready_count++;
+            }
+            AnimatedTexture::fill(stream);
+        });
+    });
+}
+
+void AnimatedTexture::advance(double seconds) {
+    {
+        std::lock_guard<std::mutex> lock{stream->mutex};
+        if(stream->ready_count == 0)
+            return;
+        frame_elapsed += seconds;
+        while(true){
+            double delay = stream->slots[stream->read_slot].delay_ms / 1000.0;
+            if(frame_elapsed < delay)
+                break;
+            if(stream->ready_count < 2){
+                // The next frame is late; hold the current one instead of skipping ahead once it arrives.
+                frame_elapsed = delay;
+                break;
+            }
+            frame_elapsed -= delay;
+            stream->read_slot = (stream->read_slot + 1) % stream->slots.size();
+            stream->ready_count--;
+        }
+        // Ask for a frame when the next one is due. A late frame asks for itself when it has been uploaded.
+        if(stream->ready_count >= 2)
+            Redraw::requestIn(stream->slots[stream->read_slot].delay_ms / 1000.0 - frame_elapsed);
+    }
+    fill(stream);
+}
+
+ImageRID AnimatedTexture::getHandle() const {
+    std::lock_guard<std::mutex> lock{stream->mutex};
+    if(stream->ready_count == 0)
+        return 0;
+    return stream->slots[stream->read_slot].handle;
+}
+
+int AnimatedTexture::getWidth() const {
+    std::lock_guard<std::mutex> lock{stream->mutex};
+    return stream->width;
+}
+
+int AnimatedTexture::getHeight() const {
+    std::lock_guard<std::mutex> lock{stream->mutex};
+    return stream->height;
+}
+
+bool AnimatedTexture::failed() const {
+    std::lock_guard<std::mutex> lock{stream->mutex};
+    return stream->failed;
+}
@@ -5,6 +5,9 @@
 #pragma once
 #include <functional>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 using ImageRID = uintptr_t;
 
@@ -12,8 +15,28 @@ namespace GPUTexture {
     void openGLUpload(ImageRID& rid, int width, int height, int num_channels, const uint8_t* bytes);
     void openGLFree(const ImageRID& rid);
 
+    /**
+     * Textures waiting to be deleted.
+     * Handles can be queued from any thread. They are deleted in one batch per frame, once a fence shows
+     * that the gpu has finished the last frame that could have drawn them.
+     */
+    namespace DeletionQueue {
+        void enqueue(ImageRID rid);
+
+        /**
+         * Called by ImGuiMain once per frame, after the frame's draw calls have been submitted.
+         */
+        void collect();
+
+        /**
+         * Wait for the gpu and delete everything that is queued. Called by ImGuiMain before the context is destroyed.
+         */
+        void flush();
+    }
+
     /**
      * A seperate thread for texture upload jobs to be appended.
+     * Jobs added before create_context() are kept, and run once the context is created.
      */
     namespace SideLoader {
         using GPUTextureJob = std::function<void()>;
@@ -22,9 +45,65 @@ namespace GPUTexture {
     }
 }
 
+enum class ImageFormat {
+    Unknown,
+    PNG,
+    JPEG,
+    GIF,
+    BMP,
+    PSD,
+    TGA,
+    HDR,
+    PIC,
+    PNM
+};
+
+/**
+ * What can be learned about an image from its header, without decoding it.
+ */
+struct ImageInfo {
+    int width{};
+    int height{};
+    int num_channels{};
+    ImageFormat format{ImageFormat::Unknown};
+};
+
+namespace ImageProbe {
+    /**
+     * Read only the header of an image file.
+     * Results are cached by path and modification time, so probing an unchanged file again does not open it.
+     * Returns false if the file is not an image that can be loaded.
+     */
+    bool probe(const std::string& image_location, ImageInfo& info);
+
+    /**
+     * Probe many images on the thread pool.
+     * on_done is called from a worker with one ImageInfo per location, in the same order.
+     * Files that could not be probed are left with the ImageFormat::Unknown format.
+     */
+    void probeAsync(std::vector<std::string> image_locations, std::function<void(std::vector<ImageInfo>)> on_done);
+
+    void clearCache();
+
+    /**
+     * Returns true if a file with this extension (".png", ".JPG", ...) is probably an image that can be loaded.
+     * Lets a listing pick out images without opening every file.
+     */
+    bool hasImageExtension(std::string_view extension);
+}
+
 class ImagePixelData;
 class Texture;
 
+/**
+ * The largest size an image is going to be displayed at.
+ * A width or height of zero means the image is kept at its full size.
+ */
+struct TargetSize {
+    int width{};
+    int height{};
+};
+
 namespace std {
     void swap(ImagePixelData& a, ImagePixelData& b);
     void swap(Texture& a, Texture& b);
@@ -43,8 +122,10 @@ private:
     std::unique_ptr<uint8_t, D> pixel_bytes;
     
     friend void std::swap(ImagePixelData& a, ImagePixelData& b);
+
+    static void shrinkToFit(ImagePixelData& image, TargetSize target_size);
 public:
-    static void load(ImagePixelData& image, const std::string& image_location, bool flip = false);
+    static void load(ImagePixelData& image, const std::string& image_location, bool flip = false, TargetSize target_size = {});
 public:
     ImagePixelData();
     ImagePixelData(const ImagePixelData& copy);
@@ -52,7 +133,7 @@ public:
 
     ImagePixelData& operator=(ImagePixelData assign);
 
-    ImagePixelData(const std::string& image_location, bool flip = false);
+    ImagePixelData(const std::string& image_location, bool flip = false, TargetSize target_size = {});
 
     inline int getWidth() const
     { return this->width; }
@@ -60,6 +141,12 @@ public:
     inline int getHeight() const
     { return this->height; }
 
+    /**
+     * Returns false if the image could not be read.
+     */
+    inline bool isLoaded() const
+    { return static_cast<bool>(this->pixel_bytes); }
+
     std::unique_ptr<uint8_t, D> clonePixelBytes() const;
     std::unique_ptr<uint8_t, D> movePixelBytes();
 };
@@ -73,7 +160,10 @@ private:
     void free();
 public:
     static void upload(Texture& texture);
-    static void uploadAsync(std::shared_ptr<Texture> texture_shared);
+    /**
+     * Upload on the side loader's context. on_uploaded is called from there once the texture can be drawn by the main context.
+     */
+    static void uploadAsync(std::shared_ptr<Texture> texture_shared, std::function<void()> on_uploaded = nullptr);
 public:
 
     Texture();
@@ -97,3 +187,40 @@ public:
     inline int getHeight() const
     { return image_data->height; }
 };
+
+/**
+ * An animated image (GIF) that is decoded one frame at a time.
+ * Frames are decoded on the thread pool into a small ring of textures, so memory use does not grow with the length of the animation.
+ */
+class AnimatedTexture {
+    struct Stream;
+    std::shared_ptr<Stream> stream;
+    double frame_elapsed;
+
+    static void fill(std::shared_ptr<Stream> stream);
+public:
+    AnimatedTexture(const std::string& image_location, size_t ring_size = 3);
+    ~AnimatedTexture();
+
+    AnimatedTexture(const AnimatedTexture& copy) = delete;
+    AnimatedTexture& operator=(const AnimatedTexture& assign) = delete;
+
+    /**
+     * Move the animation forward by the time since the last call (in seconds), respecting each frame's delay.
+     * If the next frame has not been decoded yet, the current frame stays on screen.
+     */
+    void advance(double seconds);
+
+    /**
+     * Get the resource handle of the frame to show. Returns 0 until the first frame has been uploaded.
+     */
+    ImageRID getHandle() const;
+
+    int getWidth() const;
+    int getHeight() const;
+
+    /**
+     * Returns true if the file could not be read as an animated image or a frame failed to decode.
+     */
+    bool failed() const;
+};
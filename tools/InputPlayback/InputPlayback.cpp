@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "InputPlayback.hpp"
+#include "../Profiler/Profiler.hpp"
+
+namespace InputPlayback {
+    namespace {
+        constexpr char file_magic[8] = {'I', 'M', 'I', 'N', 'P', 'U', 'T', 'S'};
+        constexpr uint32_t file_version = 1;
+
+        enum Modifiers : uint8_t {
+            Modifiers_Ctrl = 1 << 0,
+            Modifiers_Shift = 1 << 1,
+            Modifiers_Alt = 1 << 2,
+            Modifiers_Super = 1 << 3
+        };
+
+        /**
+         * Each frame is a FrameInput followed by the keys held down (uint16_t each)
+         * and the characters typed (uint32_t each).
+         */
+        struct FrameInput {
+            float delta_time;
+            float mouse_pos[2];
+            float mouse_wheel;
+            float mouse_wheel_h;
+            uint8_t mouse_down;
+            uint8_t modifiers;
+            uint16_t key_count;
+            uint16_t character_count;
+            uint16_t reserved;
+        };
+
+        struct Playback {
+            std::vector<char> bytes;
+            size_t offset = 0;
+            bool finished = false;
+            uint64_t frame_start = 0;
+            std::vector<uint64_t> frame_times;
+            // Atomic because ParallelDraw() chunks can allocate on worker threads.
+            std::atomic<uint64_t> allocations{0};
+            std::atomic<uint64_t> allocated_bytes{0};
+        };
+
+        static FILE* recording = nullptr;
+        static Playback* playback = nullptr;
+        static RunStats last_stats{};
+
+        void* mallocAlloc(size_t size, void*){
+            return malloc(size);
+        }
+
+        void mallocFree(void* ptr, void*){
+            free(ptr);
+        }
+
+        struct Allocator {
+            AllocFunc alloc_func = mallocAlloc;
+            FreeFunc free_func = mallocFree;
+            void* user_data = nullptr;
+        };
+        // The allocator ImGui uses outside of playback.
+        static Allocator app_allocator;
+
+        // ImGui frees memory allocated before playback with the counting allocator, so both forward to the app's allocator.
+        void* countingAlloc(size_t size, void*){
+            if(playback && !playback->finished){
+                playback->allocations.fetch_add(1, std::memory_order_relaxed);
+                playback->allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+            }
+            return app_allocator.alloc_func(size, app_allocator.user_data);
+        }
+
+        void countingFree(void* ptr, void*){
+            app_allocator.free_func(ptr, app_allocator.user_data);
+        }
+
+        RunStats computeStats(const Playback& run){
+            RunStats stats{};
+            stats.frames = run.frame_times.size();
+            stats.allocations = run.allocations.load();
+            stats.allocated_bytes = run.allocated_bytes.load();
+            if(run.frame_times.empty())
+                return stats;
+            std::vector<uint64_t> times = run.frame_times;
+            std::sort(times.begin(), times.end());
+            uint64_t total = 0;
+            for(uint64_t time: times)
+                total += time;
+            stats.mean_frame_ms = total / 1e6 / times.size();
+            stats.p50_frame_ms = times[times.size() / 2] / 1e6;
+            stats.p99_frame_ms = times[std::min(times.size() - 1, times.size() * 99 / 100)] / 1e6;
+            stats.max_frame_ms = times.back() / 1e6;
+            return stats;
+        }
+
+        void record(const ImGuiIO& io){
+            std::vector<uint16_t> keys;
+            for(int key = 0; key < IM_ARRAYSIZE(io.KeysDown); key++)
+                if(io.KeysDown[key])
+                    keys.push_back(static_cast<uint16_t>(key));
+            std::vector<uint32_t> characters;
+            for(int i = 0; i < io.InputQueueCharacters.Size; i++)
+                characters.push_back(io.InputQueueCharacters[i]);
+
+            FrameInput frame{};
+            frame.delta_time = io.DeltaTime;
+            frame.mouse_pos[0] = io.MousePos.x;
+            frame.mouse_pos[1] = io.MousePos.y;
+            frame.mouse_wheel = io.MouseWheel;
+            frame.mouse_wheel_h = io.MouseWheelH;
+            for(int button = 0; button < IM_ARRAYSIZE(io.MouseDown); button++)
+                if(io.MouseDown[button])
+                    frame.mouse_down |= 1 << button;
+            frame.modifiers = (io.KeyCtrl ? Modifiers_Ctrl : 0) | (io.KeyShift ? Modifiers_Shift : 0)
+                | (io.KeyAlt ? Modifiers_Alt : 0) | (io.KeySuper ? Modifiers_Super : 0);
+            frame.key_count = static_cast<uint16_t>(keys.size());
+            frame.character_count = static_cast<uint16_t>(characters.size());
+            fwrite(&frame, sizeof(frame), 1, recording);
+            fwrite(keys.data(), sizeof(uint16_t), keys.size(), recording);
+            fwrite(characters.data(), sizeof(uint32_t), characters.size(), recording);
+        }
+
+        void play(ImGuiIO& io){
+            Playback& run = *playback;
+            uint64_t now = Profiler::now();
+            if(run.frame_start != 0)
+                run.frame_times.push_back(now - run.frame_start);
+            run.frame_start = now;
+
+            FrameInput frame;
+            if(run.offset + sizeof(frame) > run.bytes.size()){
+                run.finished = true;
+                return;
+            }
+            memcpy(&frame, run.bytes.data() + run.offset, sizeof(frame));
+            size_t frame_size = sizeof(frame) + frame.key_count * sizeof(uint16_t) + frame.character_count * sizeof(uint32_t);
+            if(run.offset + frame_size > run.bytes.size()){
+                run.finished = true;
+                return;
+            }
+            const char* data = run.bytes.data() + run.offset + sizeof(frame);
+            run.offset += frame_size;
+
+            io.DeltaTime = frame.delta_time;
+            io.MousePos = ImVec2(frame.mouse_pos[0], frame.mouse_pos[1]);
+            io.MouseWheel = frame.mouse_wheel;
+            io.MouseWheelH = frame.mouse_wheel_h;
+            for(int button = 0; button < IM_ARRAYSIZE(io.MouseDown); button++)
+                io.MouseDown[button] = (frame.mouse_down >> button) & 1;
+            io.KeyCtrl = frame.modifiers & Modifiers_Ctrl;
+            io.KeyShift = frame.modifiers & Modifiers_Shift;
+            io.KeyAlt = frame.modifiers & Modifiers_Alt;
+            io.KeySuper = frame.modifiers & Modifiers_Super;
+            memset(io.KeysDown, 0, sizeof(io.KeysDown));
+            for(uint16_t i = 0; i < frame.key_count; i++){
+                uint16_t key;
+                memcpy(&key, data + i * sizeof(uint16_t), sizeof(key));
+                if(key < IM_ARRAYSIZE(io.KeysDown))
+                    io.KeysDown[key] = true;
+            }
+            data += frame.key_count * sizeof(uint16_t);
+            io.ClearInputCharacters();
+            for(uint16_t i = 0; i < frame.character_count; i++){
+                uint32_t character;
+                memcpy(&character, data + i * sizeof(uint32_t), sizeof(character));
+                io.AddInputCharacter(character);
+            }
+        }
+    }
+
+    bool startRecording(const std::string& file_path){
+        stopRecording();
+        recording = fopen(file_path.c_str(), "wb");
+        if(!recording)
+            return false;
+        fwrite(file_magic, sizeof(file_magic), 1, recording);
+        fwrite(&file_version, sizeof(file_version), 1, recording);
+        return true;
+    }
+
+    void stopRecording(){
+        if(recording)
+            fclose(recording);
+        recording = nullptr;
+    }
+
+    bool isRecording(){
+        return recording != nullptr;
+    }
+
+    bool startPlayback(const std::string& file_path){
+        stopPlayback();
+        FILE* file = fopen(file_path.c_str(), "rb");
+        if(!file)
+            return false;
+        auto run = new Playback();
+        char buffer[64 * 1024];
+        size_t read;
+        while((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            run->bytes.insert(run->bytes.end(), buffer, buffer + read);
+        fclose(file);
+
+        uint32_t version = 0;
+        if(run->bytes.size() >= sizeof(file_magic) + sizeof(version))
+            memcpy(&version, run->bytes.data() + sizeof(file_magic), sizeof(version));
+        if(version != file_version || memcmp(run->bytes.data(), file_magic, sizeof(file_magic)) != 0){
+            delete run;
+            return false;
+        }
+        run->offset = sizeof(file_magic) + sizeof(version);
+        playback = run;
+        ImGui::SetAllocatorFunctions(countingAlloc, countingFree);
+        return true;
+    }
+
+    void stopPlayback(){
+        if(!playback)
+            return;
+        last_stats = computeStats(*playback);
+        delete playback;
+        playback = nullptr;
+        ImGui::SetAllocatorFunctions(app_allocator.alloc_func, app_allocator.free_func, app_allocator.user_data);
+    }
+
+    void setAllocatorFunctions(AllocFunc alloc_func, FreeFunc free_func, void* user_data){
+        app_allocator.alloc_func = alloc_func;
+        app_allocator.free_func = free_func;
+        app_allocator.user_data = user_data;
+        // While playing back, the counting allocator stays and forwards to the new one.
+        if(!playback)
+            ImGui::SetAllocatorFunctions(alloc_func, free_func, user_data);
+    }
+
+    bool isPlaying(){
+        return playback != nullptr && !playback->finished;
+    }
+
+    bool playbackFinished(){
+        return playback != nullptr && playback->finished;
+    }
+
+    RunStats playbackStats(){
+        return playback ? computeStats(*playback) : last_stats;
+    }
+
+    void printStats(const RunStats& stats){
+        printf("Played back %zu frames\n", stats.frames);
+        printf("  frame time (ms): mean %.3f, p50 %.3f, p99 %.3f, max %.3f\n",
+            stats.mean_frame_ms, stats.p50_frame_ms, stats.p99_frame_ms, stats.max_frame_ms);
+        if(stats.frames > 0)
+            printf("  ImGui allocations: %llu (%.1f per frame, %llu bytes)\n",
+                static_cast<unsigned long long>(stats.allocations), static_cast<double>(stats.allocations) / stats.frames,
+                static_cast<unsigned long long>(stats.allocated_bytes));
+    }
+
+    void processFrame(ImGuiIO& io){
+        if(playback && !playback->finished)
+            play(io);
+        else if(recording)
+            record(io);
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * 2020 Jonathan Mendez
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "imgui.h"
+
+/**
+ * Record the input ImGui receives on every frame, and play it back later so that interactive scenarios
+ * (scrolling a big directory, dragging files, opening a dialog) can be run again as performance tests.
+ * Input is played back frame by frame with the recorded frame times, so a run does not depend on how fast the machine is.
+ * It is recorded as ImGui sees it rather than as window events, which lets it be played back in Headless mode.
+ */
+namespace InputPlayback {
+    struct RunStats {
+        size_t frames;
+        // Milliseconds from the start of one frame to the start of the next.
+        double mean_frame_ms;
+        double p50_frame_ms;
+        double p99_frame_ms;
+        double max_frame_ms;
+        // Allocations made through ImGui's allocator while playing back.
+        uint64_t allocations;
+        uint64_t allocated_bytes;
+    };
+
+    /**
+     * Start writing the input of every frame to the file. Returns false if it cannot be opened.
+     */
+    bool startRecording(const std::string& file_path);
+    void stopRecording();
+    bool isRecording();
+
+    /**
+     * Replace the input of the next frames with the recorded input. Returns false if the file cannot be played back.
+     */
+    bool startPlayback(const std::string& file_path);
+    void stopPlayback();
+    bool isPlaying();
+
+    using AllocFunc = void* (*)(size_t size, void* user_data);
+    using FreeFunc = void (*)(void* ptr, void* user_data);
+    /**
+     * ImGui::SetAllocatorFunctions() for apps with their own allocator. ImGui cannot tell which allocator is set,
+     * so playback counts on top of this one and sets it back when it stops. Defaults to malloc and free.
+     */
+    void setAllocatorFunctions(AllocFunc alloc_func, FreeFunc free_func, void* user_data = nullptr);
+
+    /**
+     * True once every recorded frame has been played back.
+     */
+    bool playbackFinished();
+
+    /**
+     * The statistics of the current or last playback.
+     */
+    RunStats playbackStats();
+    void printStats(const RunStats& stats);
+
+    /**
+     * Called by ImGuiMain once the input of a frame is known and before ImGui::NewFrame().
+     * Records the input, or replaces it with the recorded input.
+     */
+    void processFrame(ImGuiIO& io);
+}
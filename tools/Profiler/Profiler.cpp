@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Profiler.hpp"
+
+#include "imgui.h"
+
+namespace Profiler {
+    namespace {
+        // Zones kept per thread, and frames kept for the statistics.
+        constexpr size_t zone_capacity = 16 * 1024;
+        constexpr size_t frame_capacity = 512;
+
+        /**
+         * The zones of one thread. Only that thread writes; readers copy and then drop anything that was overwritten meanwhile.
+         */
+        struct ThreadBuffer {
+            uint32_t id;
+            std::string name;
+            std::atomic<uint64_t> written{0};
+            Zone zones[zone_capacity];
+
+            void record(const Zone& zone){
+                uint64_t index = written.load(std::memory_order_relaxed);
+                zones[index % zone_capacity] = zone;
+                written.store(index + 1, std::memory_order_release);
+            }
+
+            /**
+             * Copy the zones that are in the buffer, oldest first.
+             */
+            void read(std::vector<Zone>& out) const {
+                uint64_t end = written.load(std::memory_order_acquire);
+                uint64_t begin = end > zone_capacity ? end - zone_capacity : 0;
+                size_t first = out.size();
+                for(uint64_t i = begin; i < end; i++)
+                    out.push_back(zones[i % zone_capacity]);
+                // Zones that were overwritten while copying are torn; drop them.
+                uint64_t after = written.load(std::memory_order_acquire);
+                if(after > zone_capacity && after - zone_capacity > begin){
+                    size_t torn = static_cast<size_t>(std::min(after - zone_capacity, end) - begin);
+                    out.erase(out.begin() + first, out.begin() + first + torn);
+                }
+            }
+        };
+
+        static const auto start_time = std::chrono::steady_clock::now();
+        static std::atomic<bool> enabled{true};
+
+        static std::mutex threads_mutex;
+        static std::vector<std::unique_ptr<ThreadBuffer>> threads;
+
+        static thread_local ThreadBuffer* thread_buffer = nullptr;
+        static thread_local uint32_t thread_depth = 0;
+
+        ThreadBuffer& currentThread(){
+            if(!thread_buffer){
+                std::lock_guard<std::mutex> lock{threads_mutex};
+                threads.push_back(std::make_unique<ThreadBuffer>());
+                thread_buffer = threads.back().get();
+                thread_buffer->id = static_cast<uint32_t>(threads.size());
+                thread_buffer->name = "Thread " + std::to_string(thread_buffer->id);
+            }
+            return *thread_buffer;
+        }
+
+        // Only touched by the thread that renders.
+        struct Frame {
+            uint64_t begin;
+            uint64_t end;
+        };
+        static Frame frames[frame_capacity];
+        static size_t frame_count = 0;
+        static uint64_t frame_begin = 0;
+    }
+
+    uint64_t now(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+    }
+
+    ScopedZone::ScopedZone(const char* name)
+        : name{name}
+        , begin{enabled.load(std::memory_order_relaxed) ? now() : 0}
+    {
+        if(begin)
+            thread_depth++;
+    }
+
+    ScopedZone::~ScopedZone(){
+        if(!begin)
+            return;
+        thread_depth--;
+        currentThread().record(Zone{name, begin, now(), thread_depth});
+    }
+
+    void setEnabled(bool enable){
+        enabled = enable;
+    }
+
+    bool isEnabled(){
+        return enabled;
+    }
+
+    void setThreadName(const std::string& name){
+        auto& buffer = currentThread();
+        std::lock_guard<std::mutex> lock{threads_mutex};
+        buffer.name = name;
+    }
+
+    void beginFrame(){
+        frame_begin = now();
+    }
+
+    void endFrame(){
+        frames[frame_count % frame_capacity] = Frame{frame_begin, now()};
+        frame_count++;
+    }
+
+    void ShowOverlay(bool* open, const char* trace_file){
+        if(!ImGui::Begin("Profiler", open)){
+            ImGui::End();
+            return;
+        }
+        size_t count = std::min(frame_count, frame_capacity);
+        if(count == 0){
+            ImGui::TextDisabled("No frames yet.");
+            ImGui::End();
+            return;
+        }
+
+        // Frame times in milliseconds, oldest first.
+        std::vector<float> times(count);
+        for(size_t i = 0; i < count; i++){
+            const Frame& frame = frames[(frame_count - count + i) % frame_capacity];
+            times[i] = (frame.end - frame.begin) / 1e6f;
+        }
+        std::vector<float> sorted{times};
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](float p){ return sorted[std::min(count - 1, static_cast<size_t>(p * count))]; };
+        ImGui::Text("p50 %.2f ms  p99 %.2f ms  max %.2f ms  (%zu frames)", percentile(0.5f), percentile(0.99f), sorted.back(), count);
+        ImGui::PlotLines("##frame times", times.data(), static_cast<int>(count), 0, nullptr, 0.0f, sorted.back(), ImVec2(-1.0f, 60.0f));
+        ImGui::SameLine();
+        if(ImGui::Button("Export trace"))
+            exportChromeTrace(trace_file);
+        if(ImGui::IsItemHovered())
+            ImGui::SetTooltip("Write the zones to %s", trace_file);
+
+        // The timeline of the last frame: one lane per thread, nested zones stacked below their parent.
+        const Frame& last = frames[(frame_count - 1) % frame_capacity];
+        double span = static_cast<double>(std::max<uint64_t>(last.end - last.begin, 1));
+        float row_height = ImGui::GetTextLineHeight() + 2.0f;
+        float width = ImGui::GetContentRegionAvail().x;
+
+        std::vector<std::pair<std::string, std::vector<Zone>>> lanes;
+        {
+            std::lock_guard<std::mutex> lock{threads_mutex};
+            for(auto& thread: threads){
+                std::vector<Zone> zones;
+                thread->read(zones);
+                zones.erase(std::remove_if(zones.begin(), zones.end(), [&](const Zone& zone){
+                    return zone.end < last.begin || zone.begin > last.end;
+                }), zones.end());
+                if(!zones.empty())
+                    lanes.emplace_back(thread->name, std::move(zones));
+            }
+        }
+
+        ImDrawList* draw_list = ImGui::GetWindowDrawList();
+        for(auto& [name, zones]: lanes){
+            ImGui::TextUnformatted(name.c_str());
+            uint32_t max_depth = 0;
+            for(auto& zone: zones)
+                max_depth = std::max(max_depth, zone.depth);
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            ImGui::Dummy(ImVec2(width, row_height * (max_depth + 1)));
+            for(auto& zone: zones){
+                uint64_t begin = std::max(zone.begin, last.begin);
+                uint64_t end = std::min(zone.end, last.end);
+                ImVec2 min{origin.x + static_cast<float>((begin - last.begin) / span * width), origin.y + zone.depth * row_height};
+                ImVec2 max{origin.x + static_cast<float>((end - last.begin) / span * width), min.y + row_height - 1.0f};
+                max.x = std::max(max.x, min.x + 1.0f);
+                // Color by name, so the same zone keeps its color from frame to frame.
+                ImU32 hash = static_cast<ImU32>(std::hash<std::string>{}(zone.name));
+                draw_list->AddRectFilled(min, max, (hash & 0x007F7F7F) | 0xFF404040);
+                draw_list->PushClipRect(min, max, true);
+                draw_list->AddText(ImVec2(min.x + 2.0f, min.y), ImGui::GetColorU32(ImGuiCol_Text), zone.name);
+                draw_list->PopClipRect();
+                if(ImGui::IsMouseHoveringRect(min, max))
+                    ImGui::SetTooltip("%s: %.3f ms", zone.name, (zone.end - zone.begin) / 1e6);
+            }
+        }
+        ImGui::End();
+    }
+
+    namespace {
+        /**
+         * Write text as a quoted JSON string, since zone and thread names can hold quotes, backslashes or control characters.
+         */
+        void writeJsonString(FILE* file, const char* text){
+            fputc('"', file);
+            for(const char* c = text; *c; c++){
+                unsigned char ch = static_cast<unsigned char>(*c);
+                if(ch == '"' || ch == '\\')
+                    fprintf(file, "\\%c", ch);
+                else if(ch < 0x20)
+                    fprintf(file, "\\u%04x", ch);
+                else
+                    fputc(ch, file);
+            }
+            fputc('"', file);
+        }
+    }
+
+    bool exportChromeTrace(const std::string& file_path){
+        FILE* file = fopen(file_path.c_str(), "w");
+        if(!file)
+            return false;
+        fprintf(file, "{\"traceEvents\":[\n");
+        bool first = true;
+        std::lock_guard<std::mutex> lock{threads_mutex};
+        for(auto& thread: threads){
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",\n", thread->id);
+            writeJsonString(file, thread->name.c_str());
+            fprintf(file, "}}");
+            first = false;
+            std::vector<Zone> zones;
+            thread->read(zones);
+            for(auto& zone: zones){
+                // Timestamps are in microseconds.
+                fprintf(file, ",\n{\"name\":");
+                writeJsonString(file, zone.name);
+                fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    thread->id, zone.begin / 1e3, (zone.end - zone.begin) / 1e3);
+            }
+        }
+        fprintf(file, "\n]}\n");
+        return fclose(file) == 0;
+    }
+}
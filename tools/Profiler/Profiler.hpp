@@ -0,0 +1,81 @@
+/**
+ * 2020 Jonathan Mendez
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+
+/**
+ * Timing of scoped zones on every thread, with an overlay and an export to the Chrome trace format.
+ * Each thread writes its zones into its own ring buffer without locking; the oldest zones are overwritten.
+ * ImGuiMain times each phase of its frame, so a slow frame can be traced back to where the time went.
+ */
+namespace Profiler {
+    struct Zone {
+        // Has to outlive the profiler; normally a string literal.
+        const char* name;
+        // Nanoseconds since the profiler started.
+        uint64_t begin;
+        uint64_t end;
+        uint32_t depth;
+    };
+
+    /**
+     * Times the scope it lives in. Use the PROFILE_ZONE macro rather than naming one.
+     */
+    class ScopedZone {
+        const char* name;
+        uint64_t begin;
+    public:
+        ScopedZone(const char* name);
+        ~ScopedZone();
+
+        ScopedZone(const ScopedZone& copy) = delete;
+        ScopedZone& operator=(const ScopedZone& assign) = delete;
+    };
+
+    /**
+     * Nanoseconds since the profiler started.
+     */
+    uint64_t now();
+
+    /**
+     * Zones are only recorded while enabled, which is the default.
+     */
+    void setEnabled(bool enabled);
+    bool isEnabled();
+
+    /**
+     * Name the calling thread in the overlay and the exported trace.
+     */
+    void setThreadName(const std::string& name);
+
+    /**
+     * Called by ImGuiMain around each frame, on the thread that renders.
+     */
+    void beginFrame();
+    void endFrame();
+
+    /**
+     * Show the frame time percentiles, a graph of recent frames and a timeline of the zones of the last frame.
+     * Its "Export trace" button writes the zones to trace_file (see exportChromeTrace).
+     */
+    void ShowOverlay(bool* open = nullptr, const char* trace_file = "profile_trace.json");
+
+    /**
+     * Write every zone still in the ring buffers as a Chrome trace (chrome://tracing, Perfetto). Returns false if the file could not be written.
+     */
+    bool exportChromeTrace(const std::string& file_path);
+}
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+
+#ifndef PROFILER_DISABLE
+/**
+ * Time the rest of the enclosing scope under the given name, e.g. PROFILE_ZONE("Decode image");
+ */
+#define PROFILE_ZONE(name) Profiler::ScopedZone PROFILER_CONCAT(profile_zone_, __LINE__){name}
+#else
+#define PROFILE_ZONE(name) (void)0
+#endif
@@ -0,0 +1,64 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "Redraw.hpp"
+
+namespace Redraw {
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        static std::atomic<bool> requested{false};
+        static std::mutex mutex;
+        static std::function<void()> wake;
+        static Clock::time_point deadline = Clock::time_point::max();
+
+        void wakeMainLoop(){
+            std::lock_guard<std::mutex> lock{mutex};
+            if(wake)
+                wake();
+        }
+    }
+
+    void request(){
+        // Only the first request since the last frame has to wake the main loop.
+        if(!requested.exchange(true))
+            wakeMainLoop();
+    }
+
+    void requestIn(double seconds){
+        if(seconds <= 0.0){
+            request();
+            return;
+        }
+        auto when = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        std::lock_guard<std::mutex> lock{mutex};
+        if(when >= deadline)
+            return;
+        deadline = when;
+        // The main loop may be waiting with a later timeout; let it pick up the earlier one.
+        if(wake)
+            wake();
+    }
+
+    void setWaker(std::function<void()> waker){
+        std::lock_guard<std::mutex> lock{mutex};
+        wake = std::move(waker);
+    }
+
+    bool takeRequest(double& timeout){
+        if(requested.exchange(false))
+            return true;
+        std::lock_guard<std::mutex> lock{mutex};
+        if(deadline == Clock::time_point::max()){
+            timeout = -1.0;
+            return false;
+        }
+        auto now = Clock::now();
+        if(deadline <= now){
+            deadline = Clock::time_point::max();
+            return true;
+        }
+        timeout = std::chrono::duration<double>(deadline - now).count();
+        return false;
+    }
+}
@@ -0,0 +1,33 @@
+/**
+ * 2020 Jonathan Mendez
+ */
+#pragma once
+#include <functional>
+
+/**
+ * Asks the main loop for frames when it renders only on demand (see the IdleRendering init flag).
+ * Anything that changes what is on screen without input, e.g. a result arriving from a worker or an animation,
+ * requests a frame here. Every function can be called from any thread.
+ */
+namespace Redraw {
+    /**
+     * Render another frame as soon as possible, waking the main loop if it is waiting for events.
+     */
+    void request();
+
+    /**
+     * Render a frame no later than this many seconds from now, e.g. when the next frame of an animation is due.
+     */
+    void requestIn(double seconds);
+
+    /**
+     * Called by ImGuiMain with the function that wakes it up while it waits for events.
+     */
+    void setWaker(std::function<void()> waker);
+
+    /**
+     * Called by ImGuiMain before it waits. Returns true if a frame was requested since the last call.
+     * Otherwise timeout is set to the seconds until the earliest requestIn() deadline, or to a negative number if there is none.
+     */
+    bool takeRequest(double& timeout);
+}
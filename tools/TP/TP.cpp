@@ -3,6 +3,8 @@
 #include <queue>
 #include <thread>
 #include "TP.hpp"
+#include "../Profiler/Profiler.hpp"
+#include "../Redraw/Redraw.hpp"
 #include <iostream>
 
 namespace TP {
@@ -14,24 +16,36 @@ namespace TP {
         static std::mutex job_q_mutex;
         static std::condition_variable job_avail;
         static std::queue<std::function<void()>> jobs;
+        static std::queue<std::function<void()>> low_priority_jobs;
+        static std::queue<std::function<void()>> frame_jobs;
 
         void worker_thread(int id){
             msg_str << "Worker thread " << id << " has started." << std::endl;
+            Profiler::setThreadName("TP worker " + std::to_string(id));
 
             int num_jobs = 0;
             while(true){
                 std::function<void()> job;
+                bool frame_job;
                 /* Let the unique lock be destroyed after this code block. */{
                     std::unique_lock<std::mutex> lock(job_q_mutex);
                     job_avail.wait(lock, [](){
-                        return (jobs.size() > 0) || terminate;
+                        return (frame_jobs.size() > 0) || (jobs.size() > 0) || (low_priority_jobs.size() > 0) || terminate;
                     });
                     if(terminate)
                         break;
-                    job = jobs.front();
-                    jobs.pop();
+                    frame_job = frame_jobs.size() > 0;
+                    auto& queue = frame_job ? frame_jobs : jobs.size() > 0 ? jobs : low_priority_jobs;
+                    job = std::move(queue.front());
+                    queue.pop();
                 }
-                job();
+                {
+                    PROFILE_ZONE("TP job");
+                    job();
+                }
+                // Whatever the job produced may have to be shown.
+                if(!frame_job)
+                    Redraw::request();
                 num_jobs++;
             }
 
@@ -58,10 +72,18 @@ namespace TP {
         }
     }
 
-    void add_job(std::function<void()> job){
+    /**
+     * Low priority jobs are only taken by a worker when there are no normal jobs waiting.
+     */
+    void add_job(std::function<void()> job, Priority priority){
         {
             std::lock_guard<std::mutex> lock(job_q_mutex);
-            jobs.push(job);
+            if(priority == Priority_Low)
+                low_priority_jobs.push(std::move(job));
+            else if(priority == Priority_Frame)
+                frame_jobs.push(std::move(job));
+            else
+                jobs.push(std::move(job));
         }
         job_avail.notify_one();
     }
@@ -79,6 +101,13 @@ namespace TP {
         std::cout << msg_str.rdbuf() << std::endl;
     }
 
+    /**
+     * The number of worker threads. Zero until prepare_pool() is called, in which case added jobs do not run yet.
+     */
+    size_t thread_count(){
+        return thread_pool.size();
+    }
+
     const std::stringstream& message_stream(){
         return msg_str;
     }
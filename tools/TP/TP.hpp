@@ -1,9 +1,19 @@
+#pragma once
 #include <functional>
 #include <sstream>
 
 namespace TP {
+    enum Priority {
+        Priority_Normal,
+        // Speculative work; only run when no normal job is waiting.
+        Priority_Low,
+        // Work the frame being built waits on; run before any other job, and no redraw is asked for afterwards.
+        Priority_Frame
+    };
+
     void prepare_pool(uint32_t number_threads = 0);
-    void add_job(std::function<void()> job);
+    void add_job(std::function<void()> job, Priority priority = Priority_Normal);
     void join_pool();
+    size_t thread_count();
     const std::stringstream& message_stream();
 }
\ No newline at end of file
@@ -1,7 +1,15 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
 #include <map>
+#include <mutex>
+#include <vector>
 #include "imgui.h"
 #include "imgui_internal.h"
 #include "ui_helpers.hpp"
+#include "Profiler/Profiler.hpp"
+#include "TP/TP.hpp"
 
 namespace ImGui {
     /**
@@ -40,6 +48,310 @@ namespace ImGui {
         }
     }
 
+    namespace {
+        struct SectionCache {
+            uint64_t inputs_hash = 0;
+            bool open = false;
+            ImVec2 window_pos;
+            ImVec2 window_size;
+            ImVec2 scroll;
+            // The recorded commands keep their clip rects, which a parent being resized over the child
+            // changes without the child moving or being resized.
+            ImRect clip_rect;
+            ImFont* font = nullptr;
+            ImTextureID font_texture = nullptr;
+            float font_size = 0.0f;
+            float alpha = 0.0f;
+            bool hovered = false;
+            int last_frame = -1;
+
+            // Where the layout ended, to continue from there when the section is not run.
+            ImVec2 cursor_pos;
+            ImVec2 cursor_pos_prev_line;
+            ImVec2 cursor_max_pos;
+            ImVec2 prev_line_size;
+
+            std::unique_ptr<ImDrawList> draw_list;
+        };
+
+        static std::map<ImGuiID, SectionCache> section_caches;
+        static int section_caches_trimmed_frame = -1;
+
+        // Sections not shown for this many frames are dropped.
+        constexpr int section_cache_frames = 600;
+
+        void trimSectionCaches(){
+            int frame = ImGui::GetFrameCount();
+            if(section_caches_trimmed_frame == frame)
+                return;
+            section_caches_trimmed_frame = frame;
+            for(auto it = section_caches.begin(); it != section_caches.end(); ){
+                if(frame - it->second.last_frame > section_cache_frames)
+                    it = section_caches.erase(it);
+                else
+                    ++it;
+            }
+        }
+    }
+
+    void MakeCachedSection(Display display_section, uint64_t inputs_hash, const ImVec2& size, bool* collapsable, int collapse_flags){
+        if(!ImGui::BeginChild(display_section.first.c_str(), size)){
+            ImGui::EndChild();
+            return;
+        }
+        trimSectionCaches();
+        ImGuiContext& g = *GImGui;
+        ImGuiWindow* window = ImGui::GetCurrentWindow();
+        SectionCache& cache = section_caches[window->ID];
+
+        bool hovered = ImGui::IsWindowHovered(ImGuiHoveredFlags_ChildWindows | ImGuiHoveredFlags_AllowWhenBlockedByActiveItem);
+        bool typing = ImGui::IsWindowFocused(ImGuiFocusedFlags_ChildWindows)
+            && (g.IO.InputQueueCharacters.Size > 0 || g.IO.KeyCtrl || g.IO.KeyShift || g.IO.KeyAlt);
+        for(int key = 0; key < IM_ARRAYSIZE(g.IO.KeysDown) && !typing; key++)
+            typing = g.IO.KeysDown[key] && ImGui::IsWindowFocused(ImGuiFocusedFlags_ChildWindows);
+        bool open = collapsable ? *collapsable : true;
+        // Hovering is checked on this frame and the last, so that hover highlights go away when the mouse leaves.
+        bool run = !cache.draw_list
+            || cache.last_frame != g.FrameCount - 1
+            || cache.inputs_hash != inputs_hash
+            || cache.open != open
+            || hovered || cache.hovered || typing
+            || (g.ActiveId != 0 && g.ActiveIdWindow == window)
+            || cache.window_pos.x != window->Pos.x || cache.window_pos.y != window->Pos.y
+            || cache.window_size.x != window->Size.x || cache.window_size.y != window->Size.y
+            || cache.scroll.x != window->Scroll.x || cache.scroll.y != window->Scroll.y
+            || cache.clip_rect.Min.x != window->ClipRect.Min.x || cache.clip_rect.Min.y != window->ClipRect.Min.y
+            || cache.clip_rect.Max.x != window->ClipRect.Max.x || cache.clip_rect.Max.y != window->ClipRect.Max.y
+            || cache.font != g.Font || cache.font_texture != g.Font->ContainerAtlas->TexID || cache.font_size != g.FontSize || cache.alpha != ImGui::GetStyle().Alpha;
+        cache.last_frame = g.FrameCount;
+        cache.hovered = hovered;
+
+        ImDrawList* draw_list = window->DrawList;
+        if(!run){
+            AppendDrawList(draw_list, *cache.draw_list);
+            window->DC.CursorPos = cache.cursor_pos;
+            window->DC.CursorPosPrevLine = cache.cursor_pos_prev_line;
+            window->DC.CursorMaxPos = cache.cursor_max_pos;
+            window->DC.PrevLineSize = cache.prev_line_size;
+            ImGui::EndChild();
+            return;
+        }
+
+        int first_cmd = draw_list->CmdBuffer.Size - 1;
+        unsigned int first_elem = first_cmd >= 0 ? draw_list->CmdBuffer[first_cmd].ElemCount : 0;
+        if(first_cmd < 0)
+            first_cmd = 0;
+        if((!collapsable) |
+            (collapsable && ImGui::CollapsingHeader(display_section.first.c_str(), collapsable, collapse_flags))
+        ){
+            if(!collapsable) {
+                ImGui::Text("%s", display_section.first.c_str());
+                ImGui::Separator();
+            }
+            if(display_section.second)
+                std::invoke(display_section.second);
+        }
+
+        if(!cache.draw_list)
+            cache.draw_list = std::make_unique<ImDrawList>(ImGui::GetDrawListSharedData());
+        cache.draw_list->Clear();
+        AppendDrawList(cache.draw_list.get(), *draw_list, first_cmd, first_elem);
+        cache.inputs_hash = inputs_hash;
+        cache.open = collapsable ? *collapsable : true;
+        cache.window_pos = window->Pos;
+        cache.window_size = window->Size;
+        cache.scroll = window->Scroll;
+        cache.clip_rect = window->ClipRect;
+        cache.font = g.Font;
+        cache.font_texture = g.Font->ContainerAtlas->TexID;
+        cache.font_size = g.FontSize;
+        cache.alpha = ImGui::GetStyle().Alpha;
+        cache.cursor_pos = window->DC.CursorPos;
+        cache.cursor_pos_prev_line = window->DC.CursorPosPrevLine;
+        cache.cursor_max_pos = window->DC.CursorMaxPos;
+        cache.prev_line_size = window->DC.PrevLineSize;
+        ImGui::EndChild();
+    }
+
+    namespace {
+        /**
+         * Append all of src. Commands with the same VtxOffset share one block of vertices, which is copied at once,
+         * so their indices only need a fixed base added.
+         */
+        void appendWholeDrawList(ImDrawList* draw_list, const ImDrawList& src){
+            int c = 0;
+            while(c < src.CmdBuffer.Size){
+                unsigned int vertex_offset = src.CmdBuffer[c].VtxOffset;
+                int block_end = c + 1;
+                while(block_end < src.CmdBuffer.Size && src.CmdBuffer[block_end].VtxOffset == vertex_offset)
+                    block_end++;
+                unsigned int vertex_end = block_end < src.CmdBuffer.Size
+                    ? src.CmdBuffer[block_end].VtxOffset : static_cast<unsigned int>(src.VtxBuffer.Size);
+                int vertex_count = static_cast<int>(vertex_end - vertex_offset);
+
+                ImDrawIdx base = 0;
+                if(vertex_count > 0){
+                    draw_list->PrimReserve(0, vertex_count);
+                    base = static_cast<ImDrawIdx>(draw_list->_VtxCurrentIdx);
+                    memcpy(draw_list->_VtxWritePtr, src.VtxBuffer.Data + vertex_offset, vertex_count * sizeof(ImDrawVert));
+                    draw_list->_VtxWritePtr += vertex_count;
+                    draw_list->_VtxCurrentIdx += vertex_count;
+                }
+                for(; c < block_end; c++){
+                    const ImDrawCmd& cmd = src.CmdBuffer[c];
+                    if(cmd.UserCallback){
+                        draw_list->AddCallback(cmd.UserCallback, cmd.UserCallbackData);
+                        continue;
+                    }
+                    if(cmd.ElemCount == 0)
+                        continue;
+                    const ImDrawIdx* indices = src.IdxBuffer.Data + cmd.IdxOffset;
+                    int index_count = static_cast<int>(cmd.ElemCount);
+                    draw_list->PushClipRect(ImVec2(cmd.ClipRect.x, cmd.ClipRect.y), ImVec2(cmd.ClipRect.z, cmd.ClipRect.w));
+                    draw_list->PushTextureID(cmd.TextureId);
+                    draw_list->PrimReserve(index_count, 0);
+                    for(int i = 0; i < index_count; i++)
+                        draw_list->_IdxWritePtr[i] = static_cast<ImDrawIdx>(base + indices[i]);
+                    draw_list->_IdxWritePtr += index_count;
+                    draw_list->PopTextureID();
+                    draw_list->PopClipRect();
+                }
+            }
+        }
+    }
+
+    void AppendDrawList(ImDrawList* draw_list, const ImDrawList& src, int first_cmd, unsigned int first_elem){
+        if(first_cmd == 0 && first_elem == 0){
+            appendWholeDrawList(draw_list, src);
+            return;
+        }
+        // A partial copy only takes the vertices its indices use, so those have to be found first.
+        for(int c = first_cmd; c < src.CmdBuffer.Size; c++){
+            const ImDrawCmd& cmd = src.CmdBuffer[c];
+            unsigned int elem_begin = c == first_cmd ? first_elem : 0;
+            if(cmd.UserCallback){
+                if(elem_begin == 0)
+                    draw_list->AddCallback(cmd.UserCallback, cmd.UserCallbackData);
+                continue;
+            }
+            if(cmd.ElemCount <= elem_begin)
+                continue;
+            const ImDrawIdx* indices = src.IdxBuffer.Data + cmd.IdxOffset + elem_begin;
+            int index_count = static_cast<int>(cmd.ElemCount - elem_begin);
+
+            // Only copy the vertices this command uses.
+            unsigned int min_vertex = indices[0];
+            unsigned int max_vertex = indices[0];
+            for(int i = 1; i < index_count; i++){
+                min_vertex = ImMin<unsigned int>(min_vertex, indices[i]);
+                max_vertex = ImMax<unsigned int>(max_vertex, indices[i]);
+            }
+            int vertex_count = static_cast<int>(max_vertex - min_vertex + 1);
+
+            draw_list->PushClipRect(ImVec2(cmd.ClipRect.x, cmd.ClipRect.y), ImVec2(cmd.ClipRect.z, cmd.ClipRect.w));
+            draw_list->PushTextureID(cmd.TextureId);
+            draw_list->PrimReserve(index_count, vertex_count);
+            memcpy(draw_list->_VtxWritePtr, src.VtxBuffer.Data + cmd.VtxOffset + min_vertex, vertex_count * sizeof(ImDrawVert));
+            ImDrawIdx base = static_cast<ImDrawIdx>(draw_list->_VtxCurrentIdx);
+            for(int i = 0; i < index_count; i++)
+                draw_list->_IdxWritePtr[i] = static_cast<ImDrawIdx>(base + (indices[i] - min_vertex));
+            draw_list->_VtxWritePtr += vertex_count;
+            draw_list->_IdxWritePtr += index_count;
+            draw_list->_VtxCurrentIdx += vertex_count;
+            draw_list->PopTextureID();
+            draw_list->PopClipRect();
+        }
+    }
+
+    namespace {
+        /**
+         * Shared with the jobs, which may only get to run after ParallelDraw() has returned.
+         */
+        struct ParallelDrawState {
+            std::function<void(int, ImDrawList&)> build;
+            std::vector<ImDrawList*> draw_lists;
+            std::atomic<int> next_chunk{0};
+            std::mutex mutex;
+            std::condition_variable done;
+            int remaining;
+
+            /**
+             * Build chunks until none are left. The calling thread builds too, so a busy pool cannot hold up the frame.
+             */
+            void buildChunks(){
+                int chunk;
+                while((chunk = next_chunk++) < static_cast<int>(draw_lists.size())){
+                    {
+                        PROFILE_ZONE("ParallelDraw chunk");
+                        build(chunk, *draw_lists[chunk]);
+                    }
+                    std::lock_guard<std::mutex> lock{mutex};
+                    if(--remaining == 0)
+                        done.notify_one();
+                }
+            }
+        };
+
+        /**
+         * Kept from frame to frame with the sizes the chunk used last time, so its buffers can be grown on the main thread.
+         */
+        struct ParallelDrawList {
+            std::unique_ptr<ImDrawList> draw_list;
+            int vertices = 0;
+            int indices = 0;
+            int commands = 0;
+        };
+        static std::vector<ParallelDrawList> parallel_draw_lists;
+    }
+
+    void ParallelDraw(int chunk_count, std::function<void(int chunk, ImDrawList& draw_list)> build){
+        if(chunk_count <= 0)
+            return;
+        ImDrawList* window_draw_list = ImGui::GetWindowDrawList();
+        auto state = std::make_shared<ParallelDrawState>();
+        state->build = std::move(build);
+        state->remaining = chunk_count;
+        while(parallel_draw_lists.size() < static_cast<size_t>(chunk_count)){
+            parallel_draw_lists.emplace_back();
+            parallel_draw_lists.back().draw_list = std::make_unique<ImDrawList>(ImGui::GetDrawListSharedData());
+        }
+        ImTextureID texture = window_draw_list->_TextureIdStack.Size > 0
+            ? window_draw_list->_TextureIdStack.back() : ImGui::GetIO().Fonts->TexID;
+        for(int chunk = 0; chunk < chunk_count; chunk++){
+            ParallelDrawList& chunk_list = parallel_draw_lists[chunk];
+            ImDrawList* draw_list = chunk_list.draw_list.get();
+            draw_list->Clear();
+            draw_list->Flags = window_draw_list->Flags;
+            // ImGui::MemAlloc() counts allocations in the context without a lock, so grow the buffers here,
+            // with half again what the chunk used last frame so small changes do not allocate on a worker.
+            draw_list->VtxBuffer.reserve(chunk_list.vertices + chunk_list.vertices / 2);
+            draw_list->IdxBuffer.reserve(chunk_list.indices + chunk_list.indices / 2);
+            draw_list->CmdBuffer.reserve(chunk_list.commands + chunk_list.commands / 2 + 1);
+            draw_list->PushClipRect(window_draw_list->GetClipRectMin(), window_draw_list->GetClipRectMax());
+            draw_list->PushTextureID(texture);
+            state->draw_lists.push_back(draw_list);
+        }
+
+        size_t helpers = std::min(static_cast<size_t>(chunk_count - 1), TP::thread_count());
+        for(size_t i = 0; i < helpers; i++)
+            TP::add_job([state](){ state->buildChunks(); }, TP::Priority_Frame);
+        state->buildChunks();
+        {
+            std::unique_lock<std::mutex> lock{state->mutex};
+            state->done.wait(lock, [&](){ return state->remaining == 0; });
+        }
+
+        PROFILE_ZONE("ParallelDraw merge");
+        for(int chunk = 0; chunk < chunk_count; chunk++){
+            ParallelDrawList& chunk_list = parallel_draw_lists[chunk];
+            const ImDrawList& draw_list = *chunk_list.draw_list;
+            AppendDrawList(window_draw_list, draw_list);
+            chunk_list.vertices = draw_list.VtxBuffer.Size;
+            chunk_list.indices = draw_list.IdxBuffer.Size;
+            chunk_list.commands = draw_list.CmdBuffer.Size;
+        }
+    }
+
     void ImageAutoFit(ImTextureID user_texture_id, const ImVec2& size_to_fit, const ImVec2& uv0, const ImVec2& uv1, const ImVec4& tint_col, const ImVec4& border_col){
         auto avail_size = ImGui::GetContentRegionAvail();
         auto resize = resizeRectAToFitInRectB(size_to_fit, avail_size);
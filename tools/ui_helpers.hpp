@@ -2,6 +2,7 @@
  * 2020 Jonathan Mendez
  */
 #pragma once
+#include <cstdint>
 #include <functional>
 #include <utility>
 #include <string>
@@ -76,6 +77,32 @@ namespace ImGui {
 
     void MakeSection(Display display_section, const ImVec2& size = {0,0}, bool* collapsable = nullptr, int collapse_flags = 0);
 
+    /**
+     * Same as MakeSection, but the draw commands of the section are kept and drawn again on the next frames
+     * without calling display_section.second, until inputs_hash changes, the section is hovered or interacted with,
+     * or it is moved, resized or scrolled.
+     * inputs_hash has to change whenever anything shown in the section changes (e.g. a hash of the values it displays).
+     * Child windows, popups and tooltips opened from the section are not kept; sections with those should use MakeSection.
+     */
+    void MakeCachedSection(Display display_section, uint64_t inputs_hash, const ImVec2& size = {0,0}, bool* collapsable = nullptr, int collapse_flags = 0);
+
+    /**
+     * Append the draw commands of src to draw_list, starting from element first_elem of command first_cmd.
+     * Clip rects are copied as they are, so src has to be drawn in the same coordinates as draw_list.
+     */
+    void AppendDrawList(ImDrawList* draw_list, const ImDrawList& src, int first_cmd = 0, unsigned int first_elem = 0);
+
+    /**
+     * Build heavy custom geometry (scatter plots, heatmaps) for the current window on the thread pool.
+     * build(chunk, draw_list) is called once for every chunk in [0, chunk_count), on worker threads and in any order,
+     * with a draw list of its own that starts with the clip rect and texture of the window's draw list.
+     * It may only use ImDrawList functions; the other ImGui functions are not thread safe.
+     * The chunks are appended to the window's draw list in chunk order before this returns.
+     * Chunk buffers are grown on the calling thread from the sizes of the previous frame. A chunk that draws a lot more
+     * than last frame still grows them on its worker, where ImGui's allocation counter (MetricsActiveAllocations) can miss it.
+     */
+    void ParallelDraw(int chunk_count, std::function<void(int chunk, ImDrawList& draw_list)> build);
+
     class ScopeDisableItems {
         bool disabled;
     public: